@@ -133,6 +133,211 @@ const Draw = {
   },
 };
 
+/* ==================== WASM ENGINE (WEB WORKER) ==================== */
+// Client for engine-worker.js. Every command returns a promise for its own
+// result; commands issued in the same tick are sent as one batch, so a long
+// run (e.g. Dijkstra on 100k vertices) never blocks rendering or input.
+//
+//   const g = engine.create("Graph", 100000, false);
+//   engine.call(g, "addEdges", edgeTriples);
+//   const dist = await engine.call(g, "dijkstraView", 0); // Int32Array
+//   engine.destroy(g);
+//   const web = await engine.loadGraph("web-Google.txt", { onProgress });
+//   await engine.layoutGraph(web, { width: 1200, height: 800, onFrame });
+//   const timeline = engine.create("PersistentAVLTree");
+//   keys.forEach((k) => engine.call(timeline, "insert", k));
+//   const tree = await engine.call(timeline, "getTreeViewAt", 3); // any step
+const engine = {
+  worker: null,
+  nextHandle: 1,
+  nextSeq: 1,
+  queue: [], // commands waiting for the next flush
+  waiting: [], // { resolve, reject } for each queued command
+  pending: new Map(), // seq -> waiting list of an in-flight batch
+  flushScheduled: false,
+  start() {
+    if (this.worker) return true;
+    if (typeof Worker === "undefined") return false;
+    try {
+      this.worker = new Worker("engine-worker.js");
+    } catch (err) {
+      console.error("Engine worker failed to start:", err);
+      return false;
+    }
+    this.worker.onmessage = (event) => this.receive(event.data);
+    this.worker.onerror = (event) => {
+      console.error("Engine worker error:", event.message);
+      this.failAll(new Error(event.message || "Engine worker error"));
+    };
+    return true;
+  },
+  send(command) {
+    if (!this.start()) {
+      return Promise.reject(new Error("Web Workers are not available"));
+    }
+    return new Promise((resolve, reject) => {
+      this.queue.push(command);
+      this.waiting.push({ resolve, reject });
+      if (!this.flushScheduled) {
+        this.flushScheduled = true;
+        queueMicrotask(() => this.flush());
+      }
+    });
+  },
+  flush() {
+    this.flushScheduled = false;
+    if (this.queue.length === 0) return;
+    const seq = this.nextSeq++;
+    this.pending.set(seq, this.waiting);
+    this.worker.postMessage({ seq, commands: this.queue });
+    this.queue = [];
+    this.waiting = [];
+  },
+  receive({ seq, results, error }) {
+    const waiting = this.pending.get(seq);
+    if (!waiting) return;
+    this.pending.delete(seq);
+    waiting.forEach((entry, i) => {
+      if (i < results.length) entry.resolve(results[i]);
+      else if (i === results.length) entry.reject(new Error(error));
+      else entry.reject(new Error(`Skipped after earlier failure: ${error}`));
+    });
+  },
+  failAll(err) {
+    this.pending.forEach((waiting) => waiting.forEach((entry) => entry.reject(err)));
+    this.pending.clear();
+  },
+  // Returns the handle right away so calls can be queued behind it
+  create(type, ...args) {
+    const handle = this.nextHandle++;
+    this.send({ op: "create", handle, type, args }).catch((err) =>
+      console.error(`Engine create ${type} failed:`, err)
+    );
+    return handle;
+  },
+  call(handle, method, ...args) {
+    return this.send({ op: "call", handle, method, args });
+  },
+  destroy(handle) {
+    return this.send({ op: "destroy", handle });
+  },
+  // Streams an edge list or Matrix Market file into a new CSR Graph and
+  // resolves with its handle. source is a URL, Response, ReadableStream,
+  // ArrayBuffer or Uint8Array; each chunk is parsed before the next is
+  // read, so memory stays bounded. onProgress gets { bytes, edges,
+  // expectedEdges } after every chunk (expectedEdges is -1 if unknown).
+  async loadGraph(source, { directed = false, format = 0, remapIds = false, maxVertices, onProgress, onOriginalIds } = {}) {
+    const CHUNK = 1 << 20;
+    const graph = this.create("Graph", 0, directed, 2);
+    const loader = this.create("GraphLoader", { handle: graph }, format);
+    const report = async (bytes) => {
+      if (!onProgress) return;
+      const [edges, expectedEdges] = await Promise.all([
+        this.call(loader, "getEdgesLoaded"),
+        this.call(loader, "getExpectedEdges"),
+      ]);
+      onProgress({ bytes, edges, expectedEdges });
+    };
+    const feed = async (chunk) => {
+      if (!(await this.call(loader, "feed", chunk))) {
+        throw new Error(await this.call(loader, "getError"));
+      }
+    };
+
+    try {
+      if (remapIds) await this.call(loader, "setRemapIds", true);
+      if (maxVertices !== undefined) await this.call(loader, "setMaxVertices", maxVertices);
+      let body = source;
+      if (typeof body === "string") body = await fetch(body);
+      if (typeof Response !== "undefined" && body instanceof Response) {
+        if (!body.ok) throw new Error(`HTTP ${body.status}`);
+        body = body.body;
+      }
+      let bytes = 0;
+      if (body instanceof ArrayBuffer || ArrayBuffer.isView(body)) {
+        const all = body instanceof ArrayBuffer ? new Uint8Array(body) : body;
+        for (let at = 0; at < all.length; at += CHUNK) {
+          const chunk = all.subarray(at, Math.min(at + CHUNK, all.length));
+          await feed(chunk);
+          bytes += chunk.length;
+          await report(bytes);
+        }
+      } else {
+        const reader = body.getReader();
+        for (;;) {
+          const { done, value } = await reader.read();
+          if (done) break;
+          await feed(value);
+          bytes += value.length;
+          await report(bytes);
+        }
+      }
+      if (!(await this.call(loader, "finish"))) {
+        throw new Error(await this.call(loader, "getError"));
+      }
+      if (remapIds && onOriginalIds) onOriginalIds(await this.call(loader, "getOriginalIdsView"));
+      return graph;
+    } catch (err) {
+      this.destroy(graph);
+      throw err;
+    } finally {
+      this.destroy(loader);
+    }
+  },
+  // Runs the Barnes-Hut force layout on a Graph handle in batches of
+  // iterationsPerFrame and resolves with the final Float32Array of (x, y)
+  // per vertex id. onFrame gets the positions after every batch, so the
+  // caller can redraw while the layout settles. Positions are centred on
+  // the frame but not clamped to it; fit the view to their bounds.
+  async layoutGraph(graph, { width, height, initial, iterationsPerFrame = 10, maxIterations = 500, onFrame } = {}) {
+    const layout = this.create("ForceLayout", { handle: graph }, width, height);
+    try {
+      // Each batch's commands still go out together; awaiting all of them
+      // surfaces a failed setPositions or step instead of dropping it
+      let [, positions] = await Promise.all([
+        initial ? this.call(layout, "setPositions", initial) : null,
+        this.call(layout, "getPositionsView"),
+      ]);
+      for (let done = 0; done < maxIterations; done += iterationsPerFrame) {
+        const [, settled, view] = await Promise.all([
+          this.call(layout, "step", iterationsPerFrame),
+          this.call(layout, "isSettled"),
+          this.call(layout, "getPositionsView"),
+        ]);
+        positions = view;
+        if (onFrame) onFrame(positions);
+        if (settled) break;
+      }
+      return positions;
+    } finally {
+      this.destroy(layout);
+    }
+  },
+};
+
+// Slot names for getCountersView(), in CounterId order (data.h)
+const ENGINE_COUNTER_NAMES = [
+  "comparisons",
+  "swaps",
+  "rotations",
+  "lookups",
+  "probes",
+  "longest probe",
+  "edges scanned",
+  "relaxations",
+  "heap pushes",
+];
+
+// Logs the non-zero work counters of an engine structure, e.g.
+//   logEngineCounters("Dijkstra", await engine.call(g, "getCountersView"));
+function logEngineCounters(label, counters) {
+  const parts = [];
+  counters.forEach((value, i) => {
+    if (value !== 0) parts.push(`${ENGINE_COUNTER_NAMES[i]}: ${value}`);
+  });
+  addLog(`${label} cost — ${parts.length ? parts.join(", ") : "no work counted"}`, "info");
+}
+
 /* ==================== 1. BINARY HEAP LOGIC ==================== */
 const heapViz = {
   data: [],
@@ -0,0 +1,444 @@
+// Native microbenchmarks for data.h, built by CMake as dsv_bench:
+//
+//   dsv_bench [--max N] [--filter TEXT] [--repeat R] [--csv]
+//
+// Every benchmark runs at n = 10^2 .. 10^6 (up to --max and its own limit)
+// and reports the best of R runs. ns/op is per element for the heap, AVL
+// tree and hash table, and per vertex for the graph traversals. Setup
+// (filling the structure that is then searched or drained) is not timed.
+#include "data.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ===================== HARNESS =====================
+class Stopwatch {
+private:
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point started;
+    double total; // seconds
+
+public:
+    Stopwatch() : total(0) {}
+
+    void start() {
+        started = Clock::now();
+    }
+
+    void stop() {
+        total += std::chrono::duration<double>(Clock::now() - started).count();
+    }
+
+    double seconds() {
+        return total;
+    }
+};
+
+// xorshift32: the same inputs on every platform and run
+class Random {
+private:
+    unsigned int state;
+
+public:
+    Random(unsigned int seed) : state(seed ? seed : 1) {}
+
+    unsigned int next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    int below(int bound) {
+        return (int)(next() % (unsigned int)bound);
+    }
+};
+
+// Results are folded in here so the optimizer cannot drop the work
+volatile long long sink = 0;
+
+// Runs one benchmark at size n, timing only what it wraps in the
+// stopwatch; returns the operation count ns/op divides by
+typedef long long (*BenchFn)(int n, Stopwatch& watch);
+
+struct Benchmark {
+    const char* name;
+    BenchFn run;
+    int maxN;
+};
+
+int* randomKeys(int n, unsigned int seed) {
+    Random random(seed);
+    int* keys = new int[n];
+    for (int i = 0; i < n; i++) keys[i] = (int)(random.next() >> 1);
+    return keys;
+}
+
+// ===================== BINARY HEAP =====================
+long long heapInsert(int n, int arity, Stopwatch& watch) {
+    int* keys = randomKeys(n, 1);
+    BinaryHeap heap(true, 16, arity);
+    watch.start();
+    for (int i = 0; i < n; i++) heap.insert(keys[i]);
+    watch.stop();
+    sink += heap.getSize();
+    delete[] keys;
+    return n;
+}
+
+long long heapExtract(int n, int arity, Stopwatch& watch) {
+    int* keys = randomKeys(n, 2);
+    BinaryHeap heap(true, n, arity);
+    heap.buildFrom(keys, n);
+    long long sum = 0;
+    watch.start();
+    for (int i = 0; i < n; i++) sum += heap.extractTop();
+    watch.stop();
+    sink += sum;
+    delete[] keys;
+    return n;
+}
+
+long long binaryInsert(int n, Stopwatch& watch) {
+    return heapInsert(n, 2, watch);
+}
+
+long long binaryExtract(int n, Stopwatch& watch) {
+    return heapExtract(n, 2, watch);
+}
+
+long long quaternaryInsert(int n, Stopwatch& watch) {
+    return heapInsert(n, 4, watch);
+}
+
+long long quaternaryExtract(int n, Stopwatch& watch) {
+    return heapExtract(n, 4, watch);
+}
+
+// Every insert seals a version that shares all untouched blocks
+long long persistentHeapInsert(int n, Stopwatch& watch) {
+    int* keys = randomKeys(n, 1);
+    PersistentHeap heap;
+    watch.start();
+    for (int i = 0; i < n; i++) heap.insert(keys[i]);
+    watch.stop();
+    sink += heap.getVersionCount();
+    delete[] keys;
+    return n;
+}
+
+// ===================== AVL TREE =====================
+long long avlInsert(int n, Stopwatch& watch) {
+    int* keys = randomKeys(n, 3);
+    AVLTree tree;
+    watch.start();
+    for (int i = 0; i < n; i++) tree.insert(keys[i]);
+    watch.stop();
+    sink += tree.getSize();
+    delete[] keys;
+    return n;
+}
+
+long long avlRemove(int n, Stopwatch& watch) {
+    int* keys = randomKeys(n, 4);
+    AVLTree tree;
+    tree.insertMany(keys, n);
+    watch.start();
+    for (int i = n - 1; i >= 0; i--) tree.remove(keys[i]);
+    watch.stop();
+    sink += tree.getSize();
+    delete[] keys;
+    return n;
+}
+
+long long persistentAvlInsert(int n, Stopwatch& watch) {
+    int* keys = randomKeys(n, 3);
+    PersistentAVLTree tree;
+    watch.start();
+    for (int i = 0; i < n; i++) tree.insert(keys[i]);
+    watch.stop();
+    sink += tree.getVersionCount();
+    delete[] keys;
+    return n;
+}
+
+// Sorted input, one insert per key versus one O(n) bulk build
+long long avlInsertSorted(int n, Stopwatch& watch) {
+    AVLTree tree;
+    watch.start();
+    for (int i = 0; i < n; i++) tree.insert(i);
+    watch.stop();
+    sink += tree.getSize();
+    return n;
+}
+
+long long avlBuildSorted(int n, Stopwatch& watch) {
+    int* keys = new int[n];
+    for (int i = 0; i < n; i++) keys[i] = i;
+    AVLTree tree;
+    watch.start();
+    tree.buildFromSorted(keys, n);
+    watch.stop();
+    sink += tree.getSize();
+    delete[] keys;
+    return n;
+}
+
+// Union of n random keys with about n / 50 keys, half of them already
+// present; ns/op is per key of the smaller tree
+long long avlMerge(int n, Stopwatch& watch) {
+    int* keys = randomKeys(n, 8);
+    AVLTree big;
+    AVLTree small;
+    big.insertMany(keys, n);
+    small.insertMany(keys, n / 100 + 1);
+    for (int i = 0; i < n / 100 + 1; i++) small.insert(keys[i] ^ 1);
+    watch.start();
+    big.mergeFrom(small);
+    watch.stop();
+    sink += big.getSize();
+    delete[] keys;
+    return n / 100 + 1;
+}
+
+// ===================== HASH TABLE =====================
+long long hashInsert(int n, int mode, Stopwatch& watch) {
+    int* keys = randomKeys(n, 5);
+    HashTable table(mode);
+    watch.start();
+    for (int i = 0; i < n; i++) table.insert(keys[i], i);
+    watch.stop();
+    sink += table.getSize();
+    delete[] keys;
+    return n;
+}
+
+// Half the lookups hit, half miss
+long long hashSearch(int n, int mode, Stopwatch& watch) {
+    int* keys = randomKeys(n, 6);
+    HashTable table(mode);
+    for (int i = 0; i < n; i += 2) table.insert(keys[i], i);
+    long long sum = 0;
+    watch.start();
+    for (int i = 0; i < n; i++) sum += table.search(keys[i]);
+    watch.stop();
+    sink += sum;
+    delete[] keys;
+    return n;
+}
+
+long long chainInsert(int n, Stopwatch& watch) {
+    return hashInsert(n, HASH_CHAINING, watch);
+}
+
+long long chainSearch(int n, Stopwatch& watch) {
+    return hashSearch(n, HASH_CHAINING, watch);
+}
+
+long long openInsert(int n, Stopwatch& watch) {
+    return hashInsert(n, HASH_OPEN_ADDRESSING, watch);
+}
+
+long long openSearch(int n, Stopwatch& watch) {
+    return hashSearch(n, HASH_OPEN_ADDRESSING, watch);
+}
+
+// "user:<random>" keys into an open-addressing StringHashTable; half the
+// lookups hit, half miss
+string* randomNames(int n, unsigned int seed) {
+    int* keys = randomKeys(n, seed);
+    string* names = new string[n];
+    for (int i = 0; i < n; i++) names[i] = "user:" + intToString(keys[i]);
+    delete[] keys;
+    return names;
+}
+
+long long stringInsert(int n, Stopwatch& watch) {
+    string* names = randomNames(n, 10);
+    StringHashTable table(HASH_OPEN_ADDRESSING);
+    watch.start();
+    for (int i = 0; i < n; i++) table.insert(names[i], i);
+    watch.stop();
+    sink += table.getSize();
+    delete[] names;
+    return n;
+}
+
+long long stringSearch(int n, Stopwatch& watch) {
+    string* names = randomNames(n, 11);
+    StringHashTable table(HASH_OPEN_ADDRESSING);
+    for (int i = 0; i < n; i += 2) table.insert(names[i], i);
+    long long sum = 0;
+    watch.start();
+    for (int i = 0; i < n; i++) sum += table.search(names[i]);
+    watch.stop();
+    sink += sum;
+    delete[] names;
+    return n;
+}
+
+// ===================== GRAPH =====================
+// Undirected, 4n random weighted edges, STORAGE_AUTO (matrix up to 2048
+// vertices, CSR above), already merged so only the traversal is timed
+Graph* randomGraph(int n) {
+    Random random(7);
+    Graph* graph = new Graph(n, false);
+    for (int i = 0; i < n * 4; i++) {
+        graph->addEdge(random.below(n), random.below(n), 1 + random.below(100));
+    }
+    sink += graph->getEdgeCount();
+    return graph;
+}
+
+long long graphBfs(int n, Stopwatch& watch) {
+    Graph* graph = randomGraph(n);
+    watch.start();
+    sink += graph->bfsOrder(0).size;
+    watch.stop();
+    delete graph;
+    return n;
+}
+
+long long graphDfs(int n, Stopwatch& watch) {
+    Graph* graph = randomGraph(n);
+    watch.start();
+    sink += graph->dfsOrder(0).size;
+    watch.stop();
+    delete graph;
+    return n;
+}
+
+long long graphDijkstra(int n, Stopwatch& watch) {
+    Graph* graph = randomGraph(n);
+    watch.start();
+    sink += graph->dijkstraDistances(0).size;
+    watch.stop();
+    delete graph;
+    return n;
+}
+
+long long graphPrim(int n, Stopwatch& watch) {
+    Graph* graph = randomGraph(n);
+    watch.start();
+    sink += graph->primEdges().size;
+    watch.stop();
+    delete graph;
+    return n;
+}
+
+// Parses a 4n-edge "u\tv\tw" edge list in 64 KB chunks into CSR; ns/op
+// is per edge
+long long graphLoad(int n, Stopwatch& watch) {
+    Random random(9);
+    string text;
+    for (int i = 0; i < n * 4; i++) {
+        text += intToString(random.below(n));
+        text += '\t';
+        text += intToString(random.below(n));
+        text += '\t';
+        text += intToString(1 + random.below(100));
+        text += '\n';
+    }
+    Graph graph(0, true, STORAGE_CSR);
+    watch.start();
+    GraphLoader loader(graph, FORMAT_EDGE_LIST);
+    for (size_t at = 0; at < text.size(); at += 65536) {
+        size_t length = text.size() - at < 65536 ? text.size() - at : 65536;
+        loader.feed(text.data() + at, (int)length);
+    }
+    loader.finish();
+    watch.stop();
+    sink += graph.getEdgeCount();
+    return (long long)n * 4;
+}
+
+// ===================== FORCE LAYOUT =====================
+// Five Barnes-Hut iterations on the 4n-edge random graph; ns/op is per
+// vertex per iteration
+long long layoutStep(int n, Stopwatch& watch) {
+    Graph* graph = randomGraph(n);
+    ForceLayout layout(*graph, 1000, 1000);
+    watch.start();
+    layout.step(5);
+    watch.stop();
+    sink += layout.getIterations();
+    delete graph;
+    return (long long)n * 5;
+}
+
+// ===================== MAIN =====================
+// The chaining table has a fixed 16 buckets, so it is quadratic
+const Benchmark BENCHMARKS[] = {
+    { "heap.insert", binaryInsert, 1000000 },
+    { "heap.extract", binaryExtract, 1000000 },
+    { "heap4.insert", quaternaryInsert, 1000000 },
+    { "heap4.extract", quaternaryExtract, 1000000 },
+    { "heap.persistent.insert", persistentHeapInsert, 100000 },
+    { "avl.insert", avlInsert, 1000000 },
+    { "avl.remove", avlRemove, 1000000 },
+    { "avl.persistent.insert", persistentAvlInsert, 100000 },
+    { "avl.insert.sorted", avlInsertSorted, 1000000 },
+    { "avl.build.sorted", avlBuildSorted, 1000000 },
+    { "avl.merge", avlMerge, 1000000 },
+    { "hash.chaining.insert", chainInsert, 10000 },
+    { "hash.chaining.search", chainSearch, 10000 },
+    { "hash.open.insert", openInsert, 1000000 },
+    { "hash.open.search", openSearch, 1000000 },
+    { "hash.string.insert", stringInsert, 1000000 },
+    { "hash.string.search", stringSearch, 1000000 },
+    { "graph.bfs", graphBfs, 1000000 },
+    { "graph.dfs", graphDfs, 1000000 },
+    { "graph.dijkstra", graphDijkstra, 1000000 },
+    { "graph.prim", graphPrim, 1000000 },
+    { "graph.load", graphLoad, 1000000 },
+    { "layout.step", layoutStep, 100000 },
+};
+
+void usage(const char* program) {
+    fprintf(stderr, "usage: %s [--max N] [--filter TEXT] [--repeat R] [--csv]\n", program);
+}
+
+int main(int argc, char** argv) {
+    int maxN = 1000000;
+    int repeat = 3;
+    const char* filter = "";
+    bool csv = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) maxN = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--csv") == 0) csv = true;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (repeat < 1) repeat = 1;
+
+    if (csv) printf("benchmark,n,best_ms,ns_per_op\n");
+    else printf("%-22s %9s %12s %10s\n", "benchmark", "n", "best ms", "ns/op");
+
+    int count = (int)(sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]));
+    for (int b = 0; b < count; b++) {
+        const Benchmark& bench = BENCHMARKS[b];
+        if (strstr(bench.name, filter) == NULL) continue;
+
+        for (int n = 100; n <= maxN && n <= bench.maxN; n *= 10) {
+            double best = -1;
+            long long ops = 1;
+            for (int r = 0; r < repeat; r++) {
+                Stopwatch watch;
+                ops = bench.run(n, watch);
+                if (best < 0 || watch.seconds() < best) best = watch.seconds();
+            }
+            double ms = best * 1e3;
+            double nsPerOp = best * 1e9 / (double)(ops > 0 ? ops : 1);
+            if (csv) printf("%s,%d,%.3f,%.1f\n", bench.name, n, ms, nsPerOp);
+            else printf("%-22s %9d %12.3f %10.1f\n", bench.name, n, ms, nsPerOp);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -1,956 +1,612 @@
 #include <emscripten/emscripten.h>
 #include <emscripten/bind.h>
-#include <string>
+#include <emscripten/val.h>
+#include "data.h"
 
 using namespace emscripten;
-using namespace std;
 
-// ===================== INT TO STRING =====================
-string intToString(int num) {
-    if (num == 0) {
-        return "0";
-    }
-    string result = "";
-    bool negative = false;
-    if (num < 0) {
-        negative = true;
-        num = -num;
-    }
-    while (num > 0) {
-        result = char('0' + (num % 10)) + result;
-        num /= 10;
-    }
-    if (negative) {
-        result = "-" + result;
-    }
-    return result;
-}
-// ===================== LINKED LIST NODE =====================
-struct Node {
-    int data;
-    Node* next;
-
-    Node(int data) : data(data), next(NULL) {}
-};
-
-// ===================== QUEUE =====================
-class Queue {
-private:
-    Node* front;
-    Node* rear;
-    int size;
-
-public:
-    Queue() : front(NULL), rear(NULL), size(0) {}
-
-    ~Queue() {
-        while (!empty()) {
-            dequeue();
-        }
-    }
-
-    void enqueue(int data) {
-        Node* newNode = new Node(data);
-        if (rear == NULL) {
-            front = rear = newNode;
-        }
-        else {
-            rear->next = newNode;
-            rear = newNode;
-        }
-        size++;
-    }
-
-    void dequeue() {
-        if (empty())
-            return;
-        Node* temp = front;
-        front = front->next;
-        if (front == NULL) {
-            rear = NULL;
-        }
-        delete temp;
-        size--;
-    }
-
-    int Front() {
-        if (empty()) 
-            return -1;
-        return front->data;
-    }
-
-    bool empty() {
-        return size == 0;
-    }
-};
-
-// ===================== STACK =====================
-class Stack {
-private:
-    Node* top;
-    int size;
-
-public:
-    Stack() : top(NULL), size(0) {}
-
-    ~Stack() {
-        while (!empty()) {
-            pop();
-        }
-    }
-
-    void push(int data) {
-        Node* newNode = new Node(data);
-        newNode->next = top;
-        top = newNode;
-        size++;
-    }
-
-    void pop() {
-        if (empty()) 
-            return;
-        Node* temp = top;
-        top = top->next;
-        delete temp;
-        size--;
-    }
-
-    int Top() {
-        if (empty()) 
-            return -1;
-        return top->data;
-    }
-
-    bool empty() {
-        return size == 0;
-    }
-};
-
-// ===================== MIN HEAP (FOR PRIM/DIJKSTRA) =====================
-struct PQNode {
-    int vertex;
-    int key;
-};
-
-class MinHeap {
-private:
-    PQNode* heap;
-    int size;
-    int capacity;
-
-    void swap(PQNode& a, PQNode& b) {
-        PQNode temp = a;
-        a = b;
-        b = temp;
-    }
-
-    void heapifyUp(int i) {
-        while (i > 1 && heap[i].key < heap[i / 2].key) {
-            swap(heap[i], heap[i / 2]);
-            i = i / 2;
-        }
-    }
-
-    void heapifyDown(int i) {
-        int smallest = i;
-        int left = 2 * i;
-        int right = 2 * i + 1;
-
-        if (left <= size && heap[left].key < heap[smallest].key)
-            smallest = left;
-        if (right <= size && heap[right].key < heap[smallest].key)
-            smallest = right;
-
-        if (smallest != i) {
-            swap(heap[i], heap[smallest]);
-            heapifyDown(smallest);
-        }
-    }
-
-public:
-    MinHeap(int cap) : size(0), capacity(cap) {
-        heap = new PQNode[capacity + 1];
-    }
-
-    ~MinHeap() {
-        delete[] heap;
-    }
-
-    void push(int vertex, int key) {
-        if (size >= capacity) return;
-        size++;
-        heap[size].vertex = vertex;
-        heap[size].key = key;
-        heapifyUp(size);
-    }
-
-    PQNode pop() {
-        if (size == 0) return { -1, 999999 };
-        PQNode top = heap[1];
-        heap[1] = heap[size];
-        size--;
-        if (size > 0) heapifyDown(1);
-        return top;
-    }
-
-    bool empty() {
-        return size == 0;
-    }
-};
-
-// ===================== 1. BINARY HEAP =====================
-class BinaryHeap {
-private:
-    int* arr;
-    int size;
-    int cap;
-    bool isMin;
-
-    void swap(int& a, int& b) {
-        int t = a;
-        a = b;
-        b = t;
-    }
-
-    void heapifyUp(int i) {
-        while (i > 1) {
-            int parent = i / 2;
-            if (isMin && arr[parent] > arr[i]) {
-                swap(arr[i], arr[parent]);
-                i = parent;
-            }
-            else if (!isMin && arr[parent] < arr[i]) {
-                swap(arr[i], arr[parent]);
-                i = parent;
-            }
-            else {
-                break;
-            }
-        }
-    }
-
-    void heapifyDown(int i) {
-        int target = i;
-        int left = 2 * i;
-        int right = 2 * i + 1;
-
-        if (left <= size) {
-            if (isMin && arr[left] < arr[target])
-                target = left;
-            else if (!isMin && arr[left] > arr[target])
-                target = left;
-        }
-
-        if (right <= size) {
-            if (isMin && arr[right] < arr[target])
-                target = right;
-            else if (!isMin && arr[right] > arr[target])
-                target = right;
-        }
-
-        if (target != i) {
-            swap(arr[i], arr[target]);
-            heapifyDown(target);
-        }
-    }
-
-    void buildHeap() {
-        for (int i = size / 2; i >= 1; i--) {
-            heapifyDown(i);
-        }
-    }
-
-public:
-    BinaryHeap(bool minHeap = true) : size(0), cap(100), isMin(minHeap) {
-        arr = new int[cap + 1];
-    }
-
-    ~BinaryHeap() {
-        delete[] arr;
-    }
-
-    void insert(int val) {
-        if (size == cap) 
-            return;
-        size++;
-        arr[size] = val;
-        heapifyUp(size);
-    }
-
-    int extractTop() {
-        if (size == 0) 
-            return -999999;
-        int root = arr[1];
-        arr[1] = arr[size];
-        size--;
-        if (size > 0) heapifyDown(1);
-        return root;
-    }
-
-    void convertToMinHeap() {
-        isMin = true;
-        buildHeap();
-    }
-
-    void convertToMaxHeap() {
-        isMin = false;
-        buildHeap();
-    }
-
-    bool getIsMinHeap() {
-        return isMin;
-    }
-
-    string getArray() {
-        string result = "[";
-        for (int i = 1; i <= size; i++) {
-            result += intToString(arr[i]);
-            if (i < size) 
-                result += ",";
-        }
-        result += "]";
-        return result;
-    }
-
-    void clear() {
-        size = 0;
-    }
-};
-
-// ===================== 2. AVL TREE =====================
-class AVL {
-private:
-    struct Node {
-        int key;
-        int height;
-        Node* left;
-        Node* right;
-
-        Node(int k) {
-            key = k;
-            height = 1;
-            left = right = 0;
-            right = 0;
-        }
-    };
-
-    Node* root;
-
-    // own max function
-    int max(int a, int b) {
-        return (a > b) ? a : b;
-    }
-
-    int height(Node* n) {
-        return (n == 0) ? 0 : n->height;
-    }
-
-    int getBalance(Node* n) {
-        if (n == 0) return 0;
-        return height(n->left) - height(n->right);
-    }
-
-    // Right rotation (LL)
-    Node* rightRotate(Node* y) {
-        Node* x = y->left;
-        Node* T2 = x->right;
-
-        x->right = y;
-        y->left = T2;
-
-        y->height = 1 + max(height(y->left), height(y->right));
-        x->height = 1 + max(height(x->left), height(x->right));
-
-        return x;
-    }
-
-    // Left rotation (RR)
-    Node* leftRotate(Node* x) {
-        Node* y = x->right;
-        Node* T2 = y->left;
-
-        y->left = x;
-        x->right = T2;
+// ===================== TYPED ARRAY VIEWS =====================
+// Int32Array views over wasm memory: no string building, no JSON parsing.
+// See IntBuffer for how long a view stays valid.
+val toView(const int* data, int size) {
+    return val(typed_memory_view(size, data));
+}
 
-        x->height = 1 + max(height(x->left), height(x->right));
-        y->height = 1 + max(height(y->left), height(y->right));
+val toView(const IntBuffer& buf) {
+    return toView(buf.data, buf.size);
+}
 
-        return y;
-    }
+val heapArrayView(BinaryHeap& heap) {
+    return toView(heap.data(), heap.getSize());
+}
 
-    // Insert helper
-    Node* insert(Node* node, int key) {
-        if (node == 0)
-            return new Node(key);
-
-        if (key < node->key)
-            node->left = insert(node->left, key);
-        else if (key > node->key)
-            node->right = insert(node->right, key);
-        else
-            return node; // duplicates not allowed
-
-        node->height = 1 + max(height(node->left), height(node->right));
-        int balance = getBalance(node);
-
-        // LL
-        if (balance > 1 && key < node->left->key)
-            return rightRotate(node);
-
-        // RR
-        if (balance < -1 && key > node->right->key)
-            return leftRotate(node);
-
-        // LR
-        if (balance > 1 && key > node->left->key) {
-            node->left = leftRotate(node->left);
-            return rightRotate(node);
-        }
-
-        // RL
-        if (balance < -1 && key < node->right->key) {
-            node->right = rightRotate(node->right);
-            return leftRotate(node);
-        }
-
-        return node;
-    }
+val persistentHeapView(PersistentHeap& heap, int version) {
+    return toView(heap.exportArrayAt(version));
+}
 
-    // min value node
-    Node* minValueNode(Node* node) {
-        Node* cur = node;
-        while (cur->left != 0)
-            cur = cur->left;
-        return cur;
-    }
+val persistentTreeView(PersistentAVLTree& tree, int version) {
+    return toView(tree.exportTreeAt(version));
+}
 
-    // Delete helper
-    Node* remove(Node* root, int key) {
-        if (root == 0) return root;
-
-        if (key < root->key)
-            root->left = remove(root->left, key);
-        else if (key > root->key)
-            root->right = remove(root->right, key);
-        else {
-            if (root->left == 0 || root->right == 0) {
-                Node* temp = root->left ? root->left : root->right;
-
-                if (temp == 0) {
-                    temp = root;
-                    root = 0;
-                } else {
-                    root->key = temp->key;
-                    root->left = temp->left;
-                    root->right = temp->right;
-                    root->height = temp->height;
-                }
-                delete temp;
-            }
-            else {
-                Node* temp = minValueNode(root->right);
-                root->key = temp->key;
-                root->right = remove(root->right, temp->key);
-            }
-        }
-
-        if (root == 0)
-            return root;
-
-        root->height = 1 + max(height(root->left), height(root->right));
-        int balance = getBalance(root);
-
-        // LL
-        if (balance > 1 && getBalance(root->left) >= 0)
-            return rightRotate(root);
-
-        // LR
-        if (balance > 1 && getBalance(root->left) < 0) {
-            root->left = leftRotate(root->left);
-            return rightRotate(root);
-        }
-
-        // RR
-        if (balance < -1 && getBalance(root->right) <= 0)
-            return leftRotate(root);
-
-        // RL
-        if (balance < -1 && getBalance(root->right) > 0) {
-            root->right = rightRotate(root->right);
-            return leftRotate(root);
-        }
-
-        return root;
-    }
+val avlTreeView(AVLTree& tree) {
+    return toView(tree.exportTree());
+}
 
-    // Inorder printing (you can replace with your own print)
-    void inorder(Node* n) {
-        if (n == 0) return;
-        inorder(n->left);
-        // replace this with your own print function
-        print(n->key);
-        inorder(n->right);
-    }
+val avlSubtreeView(AVLTree& tree, int key) {
+    return toView(tree.exportSubtreeAt(key));
+}
 
-    // Dummy print that you can replace
-    void print(int x) {
-        // your own logic or use printf
-    }
+val avlInorderView(AVLTree& tree) {
+    return toView(tree.inorder());
+}
 
-public:
-    AVL() { root = 0; }
+val avlRangeView(AVLTree& tree, int lo, int hi) {
+    return toView(tree.rangeCollect(lo, hi));
+}
 
-    void insert(int key) {
-        root = insert(root, key);
-    }
+val avlChangedView(AVLTree& tree) {
+    return toView(tree.getChanged());
+}
 
-    void remove(int key) {
-        root = remove(root, key);
-    }
+val graphMatrixView(Graph& graph) {
+    return toView(graph.exportMatrix());
+}
 
-    void inorder() {
-        inorder(root);
-    }
-};
-
-// ===================== 3. GRAPH (ADJACENCY MATRIX) =====================
-class Graph {
-private:
-    int n;
-    int** adjMatrix;
-    bool isDirected;
-
-public:
-    Graph(int vertices, bool directed = false) : n(vertices), isDirected(directed) {
-        adjMatrix = new int* [n];
-        for (int i = 0; i < n; i++) {
-            adjMatrix[i] = new int[n];
-            for (int j = 0; j < n; j++) {
-                adjMatrix[i][j] = 0;
-            }
-        }
-    }
+val graphBfsView(Graph& graph, int start) {
+    return toView(graph.bfsOrder(start));
+}
 
-    ~Graph() {
-        for (int i = 0; i < n; i++) {
-            delete[] adjMatrix[i];
-        }
-        delete[] adjMatrix;
-    }
+val graphDirectionOptimizingBfsView(Graph& graph, int start) {
+    return toView(graph.directionOptimizingBfsOrder(start));
+}
 
-    void addEdge(int u, int v, int w = 1) {
-        if (u >= 0 && u < n && v >= 0 && v < n) {
-            adjMatrix[u][v] = w;
-            if (!isDirected && u != v) {
-                adjMatrix[v][u] = w;
-            }
-        }
-    }
+val graphLevelsView(Graph& graph) {
+    return toView(graph.getLevels());
+}
 
-    void removeEdge(int u, int v) {
-        if (u >= 0 && u < n && v >= 0 && v < n) {
-            adjMatrix[u][v] = 0;
-            if (!isDirected) {
-                adjMatrix[v][u] = 0;
-            }
-        }
-    }
+val graphDfsView(Graph& graph, int start) {
+    return toView(graph.dfsOrder(start));
+}
 
-    void setDirected(bool directed) {
-        isDirected = directed;
-        if (!directed) {
-            for (int i = 0; i < n; i++) {
-                for (int j = i + 1; j < n; j++) {
-                    if (adjMatrix[i][j] != 0 || adjMatrix[j][i] != 0) {
-                        int weight = (adjMatrix[i][j] != 0) ? adjMatrix[i][j] : adjMatrix[j][i];
-                        adjMatrix[i][j] = weight;
-                        adjMatrix[j][i] = weight;
-                    }
-                }
-            }
-        }
-    }
+val graphDijkstraView(Graph& graph, int start) {
+    return toView(graph.dijkstraDistances(start));
+}
 
-    bool getIsDirected() {
-        return isDirected;
-    }
+val graphDeltaSteppingView(Graph& graph, int start, int delta) {
+    return toView(graph.deltaSteppingDistances(start, delta));
+}
 
-    Graph* removeVertex(int vertex) {
-        if (vertex < 0 || vertex >= n) 
-            return this;
-
-        Graph* newGraph = new Graph(n - 1, isDirected);
-
-        int newI = 0;
-        for (int i = 0; i < n; i++) {
-            if (i == vertex) {
-                continue;
-            }
-
-            int newJ = 0;
-            for (int j = 0; j < n; j++) {
-                if (j == vertex) {
-                    continue;
-                }
-
-                if (adjMatrix[i][j] != 0) {
-                    newGraph->addEdge(newI, newJ, adjMatrix[i][j]);
-                }
-                newJ++;
-            }
-            newI++;
-        }
-
-        return newGraph;
-    }
+val graphIdMapView(Graph& graph) {
+    return toView(graph.getIdMap());
+}
 
-    string getMatrix() {
-        string result = "[";
-        for (int i = 0; i < n; i++) {
-            result += "[";
-            for (int j = 0; j < n; j++) {
-                result += intToString(adjMatrix[i][j]);
-                if (j < n - 1) result += ",";
-            }
-            result += "]";
-            if (i < n - 1) result += ",";
-        }
-        result += "]";
-        return result;
-    }
+val graphBidirectionalView(Graph& graph, int source, int target) {
+    return toView(graph.bidirectionalPath(source, target));
+}
 
-    string bfs(int start) {
-        if (start < 0 || start >= n) 
-            return "[]";
+val graphAStarView(Graph& graph, int source, int target) {
+    return toView(graph.aStarPath(source, target));
+}
 
-        bool* visited = new bool[n];
-        for (int i = 0; i < n; i++) visited[i] = false;
+val graphPrimView(Graph& graph) {
+    return toView(graph.primEdges());
+}
 
-        Queue q;
-        visited[start] = true;
-        q.enqueue(start);
+val graphKruskalView(Graph& graph) {
+    return toView(graph.kruskalEdges());
+}
 
-        string result = "[";
-        bool first = true;
+val graphBoruvkaView(Graph& graph) {
+    return toView(graph.boruvkaEdges());
+}
 
-        while (!q.empty()) {
-            int node = q.Front();
-            q.dequeue();
+val hashTableView(HashTable& table) {
+    return toView(table.exportTable());
+}
 
-            if (!first) result += ",";
-            first = false;
-            result += intToString(node);
+template <typename Iterator>
+val iteratorAdvanceView(Iterator& iterator, int steps) {
+    return toView(iterator.advance(steps));
+}
 
-            for (int neighbor = 0; neighbor < n; neighbor++) {
-                if (adjMatrix[node][neighbor] != 0 && !visited[neighbor]) {
-                    visited[neighbor] = true;
-                    q.enqueue(neighbor);
-                }
-            }
-        }
+template <typename Iterator>
+val iteratorPathView(Iterator& iterator, int v) {
+    return toView(iterator.pathTo(v));
+}
 
-        result += "]";
-        delete[] visited;
-        return result;
-    }
+// Float32Array of (x, y) per vertex id, valid until the next sync()
+val layoutPositionsView(ForceLayout& layout) {
+    return val(typed_memory_view(layout.getVertexCount() * 2, layout.getPositions()));
+}
 
-    string dfs(int start) {
-        if (start < 0 || start >= n) 
-            return "[]";
+// Recorded step events, oldest first, as (op, a, b, c) quadruples
+template <typename Traced>
+val traceView(Traced& owner) {
+    return toView(owner.exportTrace());
+}
 
-        bool* visited = new bool[n];
-        for (int i = 0; i < n; i++) visited[i] = false;
+// Work totals, one int per CounterId slot (see OP COUNTERS)
+template <typename Counted>
+val countersView(Counted& owner) {
+    return toView(owner.exportCounters());
+}
 
-        Stack s;
-        s.push(start);
+// Snapshot bytes (see SNAPSHOTS) as a Uint8Array, ready for IndexedDB or
+// base64 in a URL; like every view it must be copied before the next call
+template <typename Saved>
+val snapshotView(Saved& owner) {
+    IntBuffer& words = owner.serialize();
+    return val(typed_memory_view((size_t)words.size * 4, (const unsigned char*)words.data));
+}
 
-        string result = "[";
-        bool first = true;
+// ===================== JS INPUT =====================
+// Staging buffer for arrays coming from JS. One typed-array set() copies a
+// whole JS array or TypedArray into wasm memory per call.
+IntBuffer jsInput;
+
+IntBuffer& copyFromJS(const val& values) {
+    int length = values["length"].as<int>();
+    jsInput.clear();
+    jsInput.reserve(length);
+    jsInput.size = length;
+    if (length > 0) {
+        val view(typed_memory_view(length, jsInput.data));
+        view.call<void>("set", values);
+    }
+    return jsInput;
+}
 
-        while (!s.empty()) {
-            int node = s.Top();
-            s.pop();
+void heapBuildFrom(BinaryHeap& heap, const val& values) {
+    IntBuffer& input = copyFromJS(values);
+    heap.buildFrom(input.data, input.size);
+}
 
-            if (!visited[node]) {
-                visited[node] = true;
+void heapBulkInsert(BinaryHeap& heap, const val& values) {
+    IntBuffer& input = copyFromJS(values);
+    heap.bulkInsert(input.data, input.size);
+}
 
-                if (!first) result += ",";
-                first = false;
-                result += intToString(node);
+void persistentHeapBuildFrom(PersistentHeap& heap, const val& values) {
+    IntBuffer& input = copyFromJS(values);
+    heap.buildFrom(input.data, input.size);
+}
 
-                for (int neighbor = n - 1; neighbor >= 0; neighbor--) {
-                    if (adjMatrix[node][neighbor] != 0 && !visited[neighbor]) {
-                        s.push(neighbor);
-                    }
-                }
-            }
-        }
+void avlInsertMany(AVLTree& tree, const val& keys) {
+    IntBuffer& input = copyFromJS(keys);
+    tree.insertMany(input.data, input.size);
+}
 
-        result += "]";
-        delete[] visited;
-        return result;
-    }
+bool avlBuildFromSorted(AVLTree& tree, const val& keys) {
+    IntBuffer& input = copyFromJS(keys);
+    return tree.buildFromSorted(input.data, input.size);
+}
 
-    string dijkstra(int start) {
-        if (start < 0 || start >= n) 
-            return "[]";
-
-        int* dist = new int[n];
-        bool* visited = new bool[n];
-
-        for (int i = 0; i < n; i++) {
-            dist[i] = 999999;
-            visited[i] = false;
-        }
-
-        dist[start] = 0;
-        MinHeap pq(n * n);
-        pq.push(start, 0);
-
-        while (!pq.empty()) {
-            PQNode current = pq.pop();
-            int u = current.vertex;
-
-            if (visited[u]) continue;
-            visited[u] = true;
-
-            for (int v = 0; v < n; v++) {
-                if (adjMatrix[u][v] != 0 && !visited[v]) {
-                    int weight = adjMatrix[u][v];
-                    if (dist[u] + weight < dist[v]) {
-                        dist[v] = dist[u] + weight;
-                        pq.push(v, dist[v]);
-                    }
-                }
-            }
-        }
-
-        string result = "[";
-        for (int i = 0; i < n; i++) {
-            result += intToString(dist[i]);
-            if (i < n - 1) result += ",";
-        }
-        result += "]";
-
-        delete[] dist;
-        delete[] visited;
-        return result;
-    }
+void avlRemoveMany(AVLTree& tree, const val& keys) {
+    IntBuffer& input = copyFromJS(keys);
+    tree.removeMany(input.data, input.size);
+}
 
-    string primMST() {
-        if (isDirected) {
-            return "[]";
-        }
-
-        int* key = new int[n];
-        int* parent = new int[n];
-        bool* inMST = new bool[n];
-
-        for (int i = 0; i < n; i++) {
-            key[i] = 999999;
-            parent[i] = -1;
-            inMST[i] = false;
-        }
-
-        key[0] = 0;
-        MinHeap pq(n * n);
-        pq.push(0, 0);
-
-        string result = "[";
-        bool first = true;
-
-        while (!pq.empty()) {
-            PQNode current = pq.pop();
-            int u = current.vertex;
-
-            if (inMST[u]) continue;
-            inMST[u] = true;
-
-            if (parent[u] != -1) {
-                if (!first) result += ",";
-                first = false;
-                result += intToString(parent[u]) + "-" +
-                    intToString(u) + ":" +
-                    intToString(adjMatrix[parent[u]][u]);
-            }
-
-            for (int v = 0; v < n; v++) {
-                if (adjMatrix[u][v] != 0 && !inMST[v] && adjMatrix[u][v] < key[v]) {
-                    key[v] = adjMatrix[u][v];
-                    parent[v] = u;
-                    pq.push(v, key[v]);
-                }
-            }
-        }
-
-        result += "]";
-
-        delete[] key;
-        delete[] parent;
-        delete[] inMST;
-        return result;
-    }
+void graphAddEdges(Graph& graph, const val& triples) {
+    IntBuffer& input = copyFromJS(triples);
+    graph.addEdges(input.data, input.size);
+}
 
-    void clear() {
-        for (int i = 0; i < n; i++) {
-            for (int j = 0; j < n; j++) {
-                adjMatrix[i][j] = 0;
-            }
-        }
-    }
+void graphRemoveEdges(Graph& graph, const val& pairs) {
+    IntBuffer& input = copyFromJS(pairs);
+    graph.removeEdges(input.data, input.size);
+}
 
-    int getVertexCount() {
-        return n;
+// Flat x, y positions (any JS number array or Float32Array) into a new
+// float array the caller deletes
+float* copyFloatsFromJS(const val& xy, int& length) {
+    length = xy["length"].as<int>();
+    float* staging = new float[length > 0 ? length : 1];
+    if (length > 0) {
+        val view(typed_memory_view(length, staging));
+        view.call<void>("set", xy);
     }
-};
-
-// ===================== 4. HASH TABLE (CHAINING) =====================
-struct HashNode {
-    int key;
-    int value;
-    HashNode* next;
-
-    HashNode(int k, int v) : key(k), value(v), next(NULL) {}
-};
-
-class HashTable {
-private:
-    static const int TABLE_SIZE = 10;
-    HashNode** table;
-
-    int abs(int x) { return x < 0 ? -x : x; }
+    return staging;
+}
 
-    int hashFunction(int key) {
-        return abs(key) % TABLE_SIZE;
-    }
+void graphSetCoordinates(Graph& graph, const val& xy, float scale) {
+    int length;
+    float* staging = copyFloatsFromJS(xy, length);
+    graph.setCoordinates(staging, length, scale);
+    delete[] staging;
+}
 
-public:
-    HashTable() {
-        table = new HashNode * [TABLE_SIZE];
-        for (int i = 0; i < TABLE_SIZE; i++) {
-            table[i] = NULL;
-        }
-    }
+bool layoutSetPositions(ForceLayout& layout, const val& xy) {
+    int length;
+    float* staging = copyFloatsFromJS(xy, length);
+    bool ok = layout.setPositions(staging, length);
+    delete[] staging;
+    return ok;
+}
 
-    ~HashTable() {
-        for (int i = 0; i < TABLE_SIZE; i++) {
-            HashNode* current = table[i];
-            while (current) {
-                HashNode* temp = current;
-                current = current->next;
-                delete temp;
-            }
-        }
-        delete[] table;
-    }
+int graphRemoveVertices(Graph& graph, const val& vertices) {
+    IntBuffer& input = copyFromJS(vertices);
+    return graph.removeVertices(input.data, input.size);
+}
 
-    void insert(int key, int value) {
-        int index = hashFunction(key);
-
-        HashNode* current = table[index];
-        while (current) {
-            if (current->key == key) {
-                current->value = value;
-                return;
-            }
-            current = current->next;
-        }
-
-        HashNode* newNode = new HashNode(key, value);
-        newNode->next = table[index];
-        table[index] = newNode;
-    }
+void hashPutMany(HashTable& table, const val& pairs) {
+    IntBuffer& input = copyFromJS(pairs);
+    table.putMany(input.data, input.size);
+}
 
-    int search(int key) {
-        int index = hashFunction(key);
+val hashSearchMany(HashTable& table, const val& keys) {
+    IntBuffer& input = copyFromJS(keys);
+    return toView(table.searchMany(input.data, input.size));
+}
 
-        HashNode* current = table[index];
-        while (current) {
-            if (current->key == key) {
-                return current->value;
-            }
-            current = current->next;
-        }
+// Uint8Array (or ArrayBuffer view) of snapshot bytes into jsInput words
+IntBuffer& copyBytesFromJS(const val& bytes) {
+    int length = bytes["length"].as<int>();
+    int words = (length + 3) / 4;
+    jsInput.clear();
+    jsInput.reserve(words);
+    jsInput.size = words;
+    if (words > 0) {
+        jsInput.data[words - 1] = 0;
+        val view(typed_memory_view((size_t)length, (unsigned char*)jsInput.data));
+        view.call<void>("set", bytes);
+    }
+    return jsInput;
+}
 
-        return -1;
-    }
+// Next chunk of a streamed file (a Uint8Array from a ReadableStream or a
+// slice of a fetched ArrayBuffer); the bytes are copied in with one set()
+bool loaderFeed(GraphLoader& loader, const val& chunk) {
+    int length = chunk["length"].as<int>();
+    IntBuffer& input = copyBytesFromJS(chunk);
+    return loader.feed((const char*)input.data, length);
+}
 
-    string getTable() {
-        string result = "[";
+// Original id of each dense vertex id when setRemapIds(true) was used
+val loaderOriginalIdsView(GraphLoader& loader) {
+    return toView(loader.getOriginalIds());
+}
 
-        for (int i = 0; i < TABLE_SIZE; i++) {
-            result += "[";
+template <typename Saved>
+bool restoreSnapshot(Saved& owner, const val& bytes) {
+    IntBuffer& input = copyBytesFromJS(bytes);
+    return owner.deserialize(input.data, input.size);
+}
 
-            HashNode* current = table[i];
-            bool first = true;
-            while (current) {
-                if (!first) result += ",";
-                first = false;
-                result += intToString(current->key) + ":" +
-                    intToString(current->value);
-                current = current->next;
-            }
+// Worker count for the shared task pool (fixed at 1 without pthreads)
+void setThreadCount(int count) {
+    TaskPool::shared().setThreadCount(count);
+}
 
-            result += "]";
-            if (i < TABLE_SIZE - 1) result += ",";
-        }
+int getThreadCount() {
+    return TaskPool::shared().getThreadCount();
+}
 
-        result += "]";
-        return result;
-    }
+// False when built with -DDSV_NO_COUNTERS (every counter then reads 0)
+bool hasCounters() {
+    return DSV_HAS_COUNTERS != 0;
+}
 
-    void clear() {
-        for (int i = 0; i < TABLE_SIZE; i++) {
-            HashNode* current = table[i];
-            while (current) {
-                HashNode* temp = current;
-                current = current->next;
-                delete temp;
-            }
-            table[i] = NULL;
-        }
-    }
-};
+// memoryUsage() as a plain JS number
+template <typename Measured>
+double memoryUsage(Measured& owner) {
+    return (double)owner.memoryUsage();
+}
 
 // ===================== EMSCRIPTEN BINDINGS =====================
 EMSCRIPTEN_BINDINGS(data_structures) {
+    emscripten::function("setThreadCount", &setThreadCount);
+    emscripten::function("getThreadCount", &getThreadCount);
+    emscripten::function("hasCounters", &hasCounters);
+
     class_<BinaryHeap>("BinaryHeap")
         .constructor<bool>()
+        .constructor<bool, int>()
+        .constructor<bool, int, int>()
         .function("insert", &BinaryHeap::insert)
+        .function("buildFrom", &heapBuildFrom)
+        .function("bulkInsert", &heapBulkInsert)
+        .function("insertMany", &heapBulkInsert)
+        .function("reserve", &BinaryHeap::reserve)
+        .function("getCapacity", &BinaryHeap::getCapacity)
+        .function("memoryUsage", &memoryUsage<BinaryHeap>)
+        .function("shrinkToFit", &BinaryHeap::shrinkToFit)
         .function("extractTop", &BinaryHeap::extractTop)
         .function("getArray", &BinaryHeap::getArray)
+        .function("getArrayView", &heapArrayView)
         .function("clear", &BinaryHeap::clear)
+        .function("enableTrace", &BinaryHeap::enableTrace)
+        .function("disableTrace", &BinaryHeap::disableTrace)
+        .function("clearTrace", &BinaryHeap::clearTrace)
+        .function("getTraceDropped", &BinaryHeap::getTraceDropped)
+        .function("getTraceView", &traceView<BinaryHeap>)
+        .function("resetCounters", &BinaryHeap::resetCounters)
+        .function("getCountersView", &countersView<BinaryHeap>)
+        .function("serialize", &snapshotView<BinaryHeap>)
+        .function("deserialize", &restoreSnapshot<BinaryHeap>)
         .function("convertToMinHeap", &BinaryHeap::convertToMinHeap)
         .function("convertToMaxHeap", &BinaryHeap::convertToMaxHeap)
-        .function("getIsMinHeap", &BinaryHeap::getIsMinHeap);
+        .function("getIsMinHeap", &BinaryHeap::getIsMinHeap)
+        .function("getArity", &BinaryHeap::getArity)
+        .function("setArity", &BinaryHeap::setArity);
+
+    // Version timeline of a binary heap: every change seals a version,
+    // reachable with checkout() / getArrayAt() in O(1)
+    class_<PersistentHeap>("PersistentHeap")
+        .constructor<>()
+        .constructor<bool>()
+        .function("insert", &PersistentHeap::insert)
+        .function("extractTop", &PersistentHeap::extractTop)
+        .function("buildFrom", &persistentHeapBuildFrom)
+        .function("convertToMinHeap", &PersistentHeap::convertToMinHeap)
+        .function("convertToMaxHeap", &PersistentHeap::convertToMaxHeap)
+        .function("clear", &PersistentHeap::clear)
+        .function("getVersion", &PersistentHeap::getVersion)
+        .function("getVersionCount", &PersistentHeap::getVersionCount)
+        .function("checkout", &PersistentHeap::checkout)
+        .function("getSize", &PersistentHeap::getSize)
+        .function("getSizeAt", &PersistentHeap::getSizeAt)
+        .function("getIsMinHeap", &PersistentHeap::getIsMinHeap)
+        .function("getArray", &PersistentHeap::getArray)
+        .function("getArrayAt", &PersistentHeap::getArrayAt)
+        .function("getArrayViewAt", &persistentHeapView)
+        .function("discardHistory", &PersistentHeap::discardHistory)
+        .function("memoryUsage", &memoryUsage<PersistentHeap>)
+        .function("shrinkToFit", &PersistentHeap::shrinkToFit);
 
     class_<AVLTree>("AVLTree")
         .constructor<>()
         .function("insert", &AVLTree::insert)
         .function("remove", &AVLTree::remove)
+        .function("insertMany", &avlInsertMany)
+        .function("removeMany", &avlRemoveMany)
+        .function("contains", &AVLTree::contains)
+        .function("getSize", &AVLTree::getSize)
+        .function("buildFromSorted", &avlBuildFromSorted)
+        .function("mergeFrom", &AVLTree::mergeFrom)
+        .function("getInorderView", &avlInorderView)
+        .function("rank", &AVLTree::rank)
+        .function("select", &AVLTree::select)
+        .function("rangeCount", &AVLTree::rangeCount)
+        .function("rangeCollectView", &avlRangeView)
         .function("getTree", &AVLTree::getTree)
+        .function("getTreeView", &avlTreeView)
+        .function("getSubtreeView", &avlSubtreeView)
+        .function("getChangedKeys", &avlChangedView)
         .function("clear", &AVLTree::clear)
+        .function("memoryUsage", &memoryUsage<AVLTree>)
+        .function("shrinkToFit", &AVLTree::shrinkToFit)
+        .function("enableTrace", &AVLTree::enableTrace)
+        .function("disableTrace", &AVLTree::disableTrace)
+        .function("clearTrace", &AVLTree::clearTrace)
+        .function("getTraceDropped", &AVLTree::getTraceDropped)
+        .function("getTraceView", &traceView<AVLTree>)
+        .function("resetCounters", &AVLTree::resetCounters)
+        .function("getCountersView", &countersView<AVLTree>)
+        .function("serialize", &snapshotView<AVLTree>)
+        .function("deserialize", &restoreSnapshot<AVLTree>)
         .function("getLastRotation", &AVLTree::getLastRotation);
 
+    // Version timeline of an AVL tree (path copying), as PersistentHeap
+    class_<PersistentAVLTree>("PersistentAVLTree")
+        .constructor<>()
+        .function("insert", &PersistentAVLTree::insert)
+        .function("remove", &PersistentAVLTree::remove)
+        .function("clear", &PersistentAVLTree::clear)
+        .function("contains", &PersistentAVLTree::contains)
+        .function("getVersion", &PersistentAVLTree::getVersion)
+        .function("getVersionCount", &PersistentAVLTree::getVersionCount)
+        .function("checkout", &PersistentAVLTree::checkout)
+        .function("getSize", &PersistentAVLTree::getSize)
+        .function("getSizeAt", &PersistentAVLTree::getSizeAt)
+        .function("getTree", &PersistentAVLTree::getTree)
+        .function("getTreeAt", &PersistentAVLTree::getTreeAt)
+        .function("getTreeViewAt", &persistentTreeView)
+        .function("getLastRotation", &PersistentAVLTree::getLastRotation)
+        .function("getRotationAt", &PersistentAVLTree::getRotationAt)
+        .function("discardHistory", &PersistentAVLTree::discardHistory)
+        .function("memoryUsage", &memoryUsage<PersistentAVLTree>)
+        .function("shrinkToFit", &PersistentAVLTree::shrinkToFit);
+
     class_<Graph>("Graph")
         .constructor<int, bool>()
+        .constructor<int, bool, int>()
         .function("addEdge", &Graph::addEdge)
         .function("removeEdge", &Graph::removeEdge)
+        .function("addEdges", &graphAddEdges)
+        .function("removeEdges", &graphRemoveEdges)
         .function("setDirected", &Graph::setDirected)
         .function("getIsDirected", &Graph::getIsDirected)
-        .function("removeVertex", &Graph::removeVertex, allow_raw_pointers())
+        .function("getStorageMode", &Graph::getStorageMode)
+        .function("setStorageMode", &Graph::setStorageMode)
+        .function("getEdgeCount", &Graph::getEdgeCount)
+        .function("addVertex", &Graph::addVertex)
+        .function("removeVertex", &Graph::removeVertex)
+        .function("removeVertices", &graphRemoveVertices)
+        .function("isAlive", &Graph::isAlive)
+        .function("getLiveVertexCount", &Graph::getLiveVertexCount)
+        .function("compact", &Graph::compact)
+        .function("memoryUsage", &memoryUsage<Graph>)
+        .function("shrinkToFit", &Graph::shrinkToFit)
+        .function("getIdMapView", &graphIdMapView)
+        .function("getCompactionCount", &Graph::getCompactionCount)
         .function("getMatrix", &Graph::getMatrix)
+        .function("getMatrixView", &graphMatrixView)
         .function("bfs", &Graph::bfs)
+        .function("bfsView", &graphBfsView)
+        .function("directionOptimizingBfs", &Graph::directionOptimizingBfs)
+        .function("directionOptimizingBfsView", &graphDirectionOptimizingBfsView)
+        .function("getBfsLevelsView", &graphLevelsView)
         .function("dfs", &Graph::dfs)
+        .function("dfsView", &graphDfsView)
         .function("dijkstra", &Graph::dijkstra)
+        .function("dijkstraView", &graphDijkstraView)
+        .function("deltaStepping", &Graph::deltaStepping)
+        .function("deltaSteppingView", &graphDeltaSteppingView)
+        .function("bidirectionalDijkstra", &Graph::bidirectionalDijkstra)
+        .function("bidirectionalDijkstraView", &graphBidirectionalView)
+        .function("aStar", &Graph::aStar)
+        .function("aStarView", &graphAStarView)
+        .function("getPathDistance", &Graph::getPathDistance)
+        .function("setCoordinates", &graphSetCoordinates)
+        .function("setHeuristic", &Graph::setHeuristic)
+        .function("getHeuristic", &Graph::getHeuristic)
         .function("primMST", &Graph::primMST)
+        .function("primMSTView", &graphPrimView)
+        .function("kruskalMST", &Graph::kruskalMST)
+        .function("kruskalMSTView", &graphKruskalView)
+        .function("boruvkaMST", &Graph::boruvkaMST)
+        .function("boruvkaMSTView", &graphBoruvkaView)
         .function("clear", &Graph::clear)
+        .function("enableTrace", &Graph::enableTrace)
+        .function("disableTrace", &Graph::disableTrace)
+        .function("clearTrace", &Graph::clearTrace)
+        .function("getTraceDropped", &Graph::getTraceDropped)
+        .function("getTraceView", &traceView<Graph>)
+        .function("resetCounters", &Graph::resetCounters)
+        .function("getCountersView", &countersView<Graph>)
+        .function("serialize", &snapshotView<Graph>)
+        .function("deserialize", &restoreSnapshot<Graph>)
+        .function("getVersion", &Graph::getVersion)
+        .function("setCacheCapacity", &Graph::setCacheCapacity)
+        .function("getCacheCapacity", &Graph::getCacheCapacity)
+        .function("clearCache", &Graph::clearCache)
+        .function("getCacheHits", &Graph::getCacheHits)
+        .function("getCacheMisses", &Graph::getCacheMisses)
         .function("getVertexCount", &Graph::getVertexCount);
 
+    class_<BfsIterator>("BfsIterator")
+        .constructor<Graph&, int>()
+        .function("next", &BfsIterator::next)
+        .function("advance", &BfsIterator::step)
+        .function("advanceView", &iteratorAdvanceView<BfsIterator>)
+        .function("stopAt", &BfsIterator::stopAt)
+        .function("isDone", &BfsIterator::isDone)
+        .function("memoryUsage", &memoryUsage<BfsIterator>)
+        .function("pathTo", &BfsIterator::path)
+        .function("pathToView", &iteratorPathView<BfsIterator>);
+
+    class_<DfsIterator>("DfsIterator")
+        .constructor<Graph&, int>()
+        .function("next", &DfsIterator::next)
+        .function("advance", &DfsIterator::step)
+        .function("advanceView", &iteratorAdvanceView<DfsIterator>)
+        .function("stopAt", &DfsIterator::stopAt)
+        .function("isDone", &DfsIterator::isDone)
+        .function("memoryUsage", &memoryUsage<DfsIterator>)
+        .function("pathTo", &DfsIterator::path)
+        .function("pathToView", &iteratorPathView<DfsIterator>);
+
+    class_<DijkstraIterator>("DijkstraIterator")
+        .constructor<Graph&, int>()
+        .function("next", &DijkstraIterator::next)
+        .function("advance", &DijkstraIterator::step)
+        .function("advanceView", &iteratorAdvanceView<DijkstraIterator>)
+        .function("stopAt", &DijkstraIterator::stopAt)
+        .function("isDone", &DijkstraIterator::isDone)
+        .function("memoryUsage", &memoryUsage<DijkstraIterator>)
+        .function("getDistance", &DijkstraIterator::getDistance)
+        .function("pathTo", &DijkstraIterator::path)
+        .function("pathToView", &iteratorPathView<DijkstraIterator>);
+
+    class_<GraphLoader>("GraphLoader")
+        .constructor<Graph&>()
+        .constructor<Graph&, int>()
+        .function("feed", &loaderFeed)
+        .function("finish", &GraphLoader::finish)
+        .function("getFormat", &GraphLoader::getFormat)
+        .function("getBytesRead", &GraphLoader::getBytesRead)
+        .function("getLineNumber", &GraphLoader::getLineNumber)
+        .function("getEdgesLoaded", &GraphLoader::getEdgesLoaded)
+        .function("getExpectedEdges", &GraphLoader::getExpectedEdges)
+        .function("setMaxVertices", &GraphLoader::setMaxVertices)
+        .function("getMaxVertices", &GraphLoader::getMaxVertices)
+        .function("setRemapIds", &GraphLoader::setRemapIds)
+        .function("getRemapIds", &GraphLoader::getRemapIds)
+        .function("getOriginalIdsView", &loaderOriginalIdsView)
+        .function("memoryUsage", &memoryUsage<GraphLoader>)
+        .function("shrinkToFit", &GraphLoader::shrinkToFit)
+        .function("getError", &GraphLoader::getError);
+
+    class_<ForceLayout>("ForceLayout")
+        .constructor<Graph&, float, float>()
+        .function("sync", &ForceLayout::sync)
+        .function("randomize", &ForceLayout::randomize)
+        .function("step", &ForceLayout::step)
+        .function("isSettled", &ForceLayout::isSettled)
+        .function("reheat", &ForceLayout::reheat)
+        .function("getPositionsView", &layoutPositionsView)
+        .function("setPositions", &layoutSetPositions)
+        .function("setPosition", &ForceLayout::setPosition)
+        .function("setPinned", &ForceLayout::setPinned)
+        .function("isPinned", &ForceLayout::isPinned)
+        .function("setFrame", &ForceLayout::setFrame)
+        .function("setTheta", &ForceLayout::setTheta)
+        .function("getTheta", &ForceLayout::getTheta)
+        .function("setIdealLength", &ForceLayout::setIdealLength)
+        .function("getIdealLength", &ForceLayout::getIdealLength)
+        .function("setRepulsion", &ForceLayout::setRepulsion)
+        .function("setGravity", &ForceLayout::setGravity)
+        .function("setCooling", &ForceLayout::setCooling)
+        .function("getTemperature", &ForceLayout::getTemperature)
+        .function("getIterations", &ForceLayout::getIterations)
+        .function("getVertexCount", &ForceLayout::getVertexCount)
+        .function("getEdgeCount", &ForceLayout::getEdgeCount)
+        .function("getCellCount", &ForceLayout::getCellCount)
+        .function("memoryUsage", &memoryUsage<ForceLayout>)
+        .function("shrinkToFit", &ForceLayout::shrinkToFit);
+
     class_<HashTable>("HashTable")
         .constructor<>()
+        .constructor<int>()
         .function("insert", &HashTable::insert)
         .function("search", &HashTable::search)
+        .function("putMany", &hashPutMany)
+        .function("searchMany", &hashSearchMany)
+        .function("remove", &HashTable::remove)
+        .function("getMode", &HashTable::getMode)
+        .function("setMode", &HashTable::setMode)
+        .function("setMaxLoadFactor", &HashTable::setMaxLoadFactor)
+        .function("getMaxLoadFactor", &HashTable::getMaxLoadFactor)
+        .function("getSize", &HashTable::getSize)
+        .function("getCapacity", &HashTable::getCapacity)
+        .function("memoryUsage", &memoryUsage<HashTable>)
+        .function("shrinkToFit", &HashTable::shrinkToFit)
         .function("getTable", &HashTable::getTable)
-        .function("clear", &HashTable::clear);
+        .function("getTableView", &hashTableView)
+        .function("clear", &HashTable::clear)
+        .function("enableTrace", &HashTable::enableTrace)
+        .function("disableTrace", &HashTable::disableTrace)
+        .function("clearTrace", &HashTable::clearTrace)
+        .function("getTraceDropped", &HashTable::getTraceDropped)
+        .function("getTraceView", &traceView<HashTable>)
+        .function("resetCounters", &HashTable::resetCounters)
+        .function("getCountersView", &countersView<HashTable>)
+        .function("serialize", &snapshotView<HashTable>)
+        .function("deserialize", &restoreSnapshot<HashTable>);
+
+    // String keys (JS strings, hashed as their UTF-8 bytes) to int values;
+    // traced probes record the key's hash in place of the key
+    class_<StringHashTable>("StringHashTable")
+        .constructor<>()
+        .constructor<int>()
+        .function("insert", &StringHashTable::insert)
+        .function("search", &StringHashTable::search)
+        .function("remove", &StringHashTable::remove)
+        .function("getMode", &StringHashTable::getMode)
+        .function("setMode", &StringHashTable::setMode)
+        .function("setMaxLoadFactor", &StringHashTable::setMaxLoadFactor)
+        .function("getMaxLoadFactor", &StringHashTable::getMaxLoadFactor)
+        .function("getSize", &StringHashTable::getSize)
+        .function("getCapacity", &StringHashTable::getCapacity)
+        .function("memoryUsage", &memoryUsage<StringHashTable>)
+        .function("shrinkToFit", &StringHashTable::shrinkToFit)
+        .function("getTable", &StringHashTable::getTable)
+        .function("clear", &StringHashTable::clear)
+        .function("enableTrace", &StringHashTable::enableTrace)
+        .function("disableTrace", &StringHashTable::disableTrace)
+        .function("clearTrace", &StringHashTable::clearTrace)
+        .function("getTraceDropped", &StringHashTable::getTraceDropped)
+        .function("getTraceView", &traceView<StringHashTable>)
+        .function("resetCounters", &StringHashTable::resetCounters)
+        .function("getCountersView", &countersView<StringHashTable>);
 }
\ No newline at end of file
@@ -0,0 +1,7251 @@
+// Data structures behind the visualizer, free of emscripten so they build
+// natively too (bench.cpp). data.cpp adds the JS bindings on top.
+#ifndef DATA_H
+#define DATA_H
+
+#include <math.h>
+#include <new>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+#include <utility>
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+// Threaded build: emcc -pthread defines __EMSCRIPTEN_PTHREADS__; native
+// builds opt in with -DDSV_THREADS
+#if defined(__EMSCRIPTEN_PTHREADS__) || defined(DSV_THREADS)
+#define DSV_HAS_THREADS 1
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#else
+#define DSV_HAS_THREADS 0
+#endif
+
+using namespace std;
+
+// ===================== INT TO STRING =====================
+// Digits are written backwards into a fixed buffer, so each call is linear
+// in the digit count and allocates once. Unsigned math keeps INT_MIN exact.
+inline string intToString(int num) {
+    char buf[12];
+    int pos = 12;
+    unsigned int u = (num < 0) ? 0u - (unsigned int)num : (unsigned int)num;
+    do {
+        buf[--pos] = char('0' + (u % 10));
+        u /= 10;
+    } while (u > 0);
+    if (num < 0) {
+        buf[--pos] = '-';
+    }
+    return string(buf + pos, 12 - pos);
+}
+
+// ===================== INT BUFFER =====================
+// Growable int32 array that results are written into. JS reads it through a
+// typed_memory_view, which stays valid until the owner writes the buffer
+// again or wasm memory grows; copy it (view.slice()) to keep it longer.
+struct IntBuffer {
+    int* data;
+    int size;
+    int cap;
+
+    IntBuffer() : data(NULL), size(0), cap(0) {}
+
+    ~IntBuffer() {
+        delete[] data;
+    }
+
+    void reserve(int n) {
+        if (n <= cap) return;
+        int newCap = (cap == 0) ? 16 : cap;
+        while (newCap < n) newCap *= 2;
+        int* grown = new int[newCap];
+        for (int i = 0; i < size; i++) grown[i] = data[i];
+        delete[] data;
+        data = grown;
+        cap = newCap;
+    }
+
+    void push(int x) {
+        if (size == cap) reserve(size + 1);
+        data[size++] = x;
+    }
+
+    void clear() {
+        size = 0;
+    }
+
+    // Empties the buffer and returns its storage
+    void release() {
+        delete[] data;
+        data = NULL;
+        size = 0;
+        cap = 0;
+    }
+
+    // Bytes allocated on the heap (not counting the struct itself)
+    size_t heapBytes() const {
+        return (size_t)cap * sizeof(int);
+    }
+
+private:
+    IntBuffer(const IntBuffer&);
+    IntBuffer& operator=(const IntBuffer&);
+};
+
+// "[a,b,c]"
+inline string formatList(const int* data, int count) {
+    string result = "[";
+    for (int i = 0; i < count; i++) {
+        result += intToString(data[i]);
+        if (i < count - 1) result += ",";
+    }
+    result += "]";
+    return result;
+}
+
+inline string formatList(const IntBuffer& buf) {
+    return formatList(buf.data, buf.size);
+}
+
+inline void reverseBuffer(IntBuffer& buf) {
+    for (int i = 0, j = buf.size - 1; i < j; i++, j--) {
+        int t = buf.data[i];
+        buf.data[i] = buf.data[j];
+        buf.data[j] = t;
+    }
+}
+
+// (u, v, w) triples as "[u-v:w,...]"
+inline string formatEdgeList(const IntBuffer& buf) {
+    string result = "[";
+    for (int i = 0; i + 2 < buf.size; i += 3) {
+        if (i > 0) result += ",";
+        result += intToString(buf.data[i]) + "-" +
+            intToString(buf.data[i + 1]) + ":" +
+            intToString(buf.data[i + 2]);
+    }
+    result += "]";
+    return result;
+}
+
+// ===================== TRACE BUFFER =====================
+// Opt-in step recorder. Algorithms append (op, a, b, c) events to a ring
+// preallocated by enable(); once it is full the oldest events are
+// overwritten and counted in dropped. With tracing off, record() is a
+// single branch. Per-op fields:
+//   COMPARE  heap: indices a, b, c = 1 if they swap next
+//            AVL: search key a against node key b, c = -1 left, 1 right, 0 hit
+//            Kruskal: edge a-b, c = 1 if it joined two trees
+//   SWAP     heap indices a, b
+//   ROTATE   AVL: pivot key a, new subtree root b, c = 0 right, 1 left
+//   VISIT    graph vertex a settled from b (-1 for none / unknown), c = its
+//            distance (Dijkstra) or edge weight (Prim), else 0
+//   RELAX    graph edge a -> b improved or discovered, c = new distance or key
+//   PROBE    hash bucket or slot a while looking for key b, c = slot state
+//            (open addressing), or for chaining -1 on reaching the bucket
+//            and then the position of each chain node compared
+// Heap indices count from 0, matching getArrayView().
+enum TraceOp {
+    TRACE_COMPARE = 1,
+    TRACE_SWAP = 2,
+    TRACE_ROTATE = 3,
+    TRACE_VISIT = 4,
+    TRACE_RELAX = 5,
+    TRACE_PROBE = 6
+};
+
+class TraceBuffer {
+private:
+    int* events;
+    int capacity; // in events; 0 = tracing off
+    int head;     // next event slot to write
+    int count;
+    int dropped;
+    IntBuffer ordered;
+
+    TraceBuffer(const TraceBuffer&);
+    TraceBuffer& operator=(const TraceBuffer&);
+
+public:
+    TraceBuffer() : events(NULL), capacity(0), head(0), count(0), dropped(0) {}
+
+    ~TraceBuffer() {
+        delete[] events;
+    }
+
+    // Starts recording into a ring of the given number of events
+    void enable(int length) {
+        disable();
+        if (length <= 0) return;
+        events = new int[length * 4];
+        capacity = length;
+    }
+
+    void disable() {
+        delete[] events;
+        events = NULL;
+        capacity = 0;
+        clear();
+    }
+
+    bool isEnabled() const {
+        return capacity != 0;
+    }
+
+    void clear() {
+        head = count = dropped = 0;
+    }
+
+    void record(int op, int a, int b, int c) {
+        if (capacity == 0) return;
+        int* e = events + head * 4;
+        e[0] = op;
+        e[1] = a;
+        e[2] = b;
+        e[3] = c;
+        if (++head == capacity) head = 0;
+        if (count < capacity) count++;
+        else dropped++;
+    }
+
+    int getDropped() const {
+        return dropped;
+    }
+
+    size_t heapBytes() const {
+        return (size_t)capacity * 4 * sizeof(int) + ordered.heapBytes();
+    }
+
+    // Drops the exported copy; the ring itself is sized by enable()
+    void shrink() {
+        ordered.release();
+    }
+
+    // Events oldest first, four ints each
+    IntBuffer& exportEvents() {
+        ordered.clear();
+        ordered.reserve(count * 4);
+        int first = (count < capacity) ? 0 : head;
+        for (int i = 0; i < count; i++) {
+            const int* e = events + ((first + i) % capacity) * 4;
+            for (int k = 0; k < 4; k++) ordered.data[ordered.size++] = e[k];
+        }
+        return ordered;
+    }
+};
+
+// ===================== OP COUNTERS =====================
+// Running totals of the work each structure does, so complexity claims can
+// be checked under real load. Unlike the trace these are always on; a
+// build with -DDSV_NO_COUNTERS turns add() and raise() into no-ops. Slots
+// (unused ones stay 0):
+//   COMPARE   heap: key comparisons in sift up/down; AVL: key comparisons
+//   SWAP      heap: element swaps
+//   ROTATE    AVL: single rotations (LR / RL count two)
+//   LOOKUP    hash: search() calls
+//   PROBE     hash: slots (open addressing) or chain nodes examined by them
+//   MAX_PROBE hash: longest single search, in the same units
+//   EDGE      Dijkstra / Prim: edges scanned from settled vertices
+//   RELAX     Dijkstra / Prim: scans that improved a distance or key
+//   PUSH      Dijkstra / Prim: priority queue pushes
+enum CounterId {
+    COUNT_COMPARE = 0,
+    COUNT_SWAP = 1,
+    COUNT_ROTATE = 2,
+    COUNT_LOOKUP = 3,
+    COUNT_PROBE = 4,
+    COUNT_MAX_PROBE = 5,
+    COUNT_EDGE = 6,
+    COUNT_RELAX = 7,
+    COUNT_PUSH = 8,
+    COUNTER_SLOTS = 9
+};
+
+#ifdef DSV_NO_COUNTERS
+#define DSV_HAS_COUNTERS 0
+#else
+#define DSV_HAS_COUNTERS 1
+#endif
+
+class OpCounters {
+private:
+    long long values[COUNTER_SLOTS];
+    IntBuffer exported;
+
+public:
+    OpCounters() {
+        reset();
+    }
+
+    void reset() {
+        for (int i = 0; i < COUNTER_SLOTS; i++) values[i] = 0;
+    }
+
+    void add(int id, long long amount = 1) {
+#if DSV_HAS_COUNTERS
+        values[id] += amount;
+#else
+        (void)id;
+        (void)amount;
+#endif
+    }
+
+    // Keeps the maximum seen in a slot
+    void raise(int id, long long value) {
+#if DSV_HAS_COUNTERS
+        if (value > values[id]) values[id] = value;
+#else
+        (void)id;
+        (void)value;
+#endif
+    }
+
+    long long get(int id) const {
+        return values[id];
+    }
+
+    size_t heapBytes() const {
+        return exported.heapBytes();
+    }
+
+    void shrink() {
+        exported.release();
+    }
+
+    // One int per slot, clamped to INT_MAX
+    IntBuffer& exportValues() {
+        exported.clear();
+        exported.reserve(COUNTER_SLOTS);
+        for (int i = 0; i < COUNTER_SLOTS; i++) {
+            exported.push((int)(values[i] > 2147483647LL ? 2147483647LL : values[i]));
+        }
+        return exported;
+    }
+};
+
+// ===================== SNAPSHOTS =====================
+// Versioned binary snapshot of one structure, as little-endian int32 words
+// (the byte order of wasm and of every native target):
+//   [0] SNAPSHOT_MAGIC ("DSVS")   [1] SNAPSHOT_VERSION   [2] SnapshotKind
+//   [3] payload word count        [4 ..] payload         [last] checksum
+// Floats are stored as their bit patterns. Each serialize() documents its
+// payload. deserialize() returns false and leaves the structure untouched
+// on a bad header, length or checksum (FNV-1a over the payload words); a
+// payload that checks out but does not describe a valid structure leaves
+// it empty.
+static const int SNAPSHOT_MAGIC = 0x53565344;
+static const int SNAPSHOT_VERSION = 1;
+
+enum SnapshotKind {
+    SNAPSHOT_HEAP = 1,
+    SNAPSHOT_AVL = 2,
+    SNAPSHOT_GRAPH = 3,
+    SNAPSHOT_HASH = 4
+};
+
+inline uint32_t snapshotChecksum(const int* words, int count) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < count; i++) h = (h ^ (uint32_t)words[i]) * 16777619u;
+    return h;
+}
+
+class SnapshotWriter {
+private:
+    IntBuffer& out;
+
+public:
+    SnapshotWriter(IntBuffer& buffer, int kind) : out(buffer) {
+        out.clear();
+        out.push(SNAPSHOT_MAGIC);
+        out.push(SNAPSHOT_VERSION);
+        out.push(kind);
+        out.push(0);
+    }
+
+    void put(int word) {
+        out.push(word);
+    }
+
+    void putFloat(float value) {
+        int word;
+        memcpy(&word, &value, sizeof(word));
+        out.push(word);
+    }
+
+    // Position of the next word, for a count patched in once known
+    int mark() {
+        out.push(0);
+        return out.size - 1;
+    }
+
+    void patch(int at, int word) {
+        out.data[at] = word;
+    }
+
+    // Fills in the length and appends the checksum
+    IntBuffer& finish() {
+        int payload = out.size - 4;
+        out.data[3] = payload;
+        out.push((int)snapshotChecksum(out.data + 4, payload));
+        return out;
+    }
+};
+
+class SnapshotReader {
+private:
+    const int* words;
+    int pos;
+    int end; // one past the payload
+    bool ok;
+
+public:
+    SnapshotReader(const int* data, int length, int kind) : words(data), pos(4), end(4), ok(false) {
+        if (length < 5 || data[0] != SNAPSHOT_MAGIC || data[1] != SNAPSHOT_VERSION || data[2] != kind)
+            return;
+        int payload = data[3];
+        if (payload < 0 || payload != length - 5)
+            return;
+        if ((int)snapshotChecksum(data + 4, payload) != data[length - 1])
+            return;
+        end = 4 + payload;
+        ok = true;
+    }
+
+    // False once the header was rejected or a read ran past the payload
+    bool valid() const {
+        return ok;
+    }
+
+    int remaining() const {
+        return end - pos;
+    }
+
+    bool atEnd() const {
+        return pos == end;
+    }
+
+    int peek() const {
+        return (pos < end) ? words[pos] : 0;
+    }
+
+    // The next unread word, for a second pass over validated data
+    const int* cursor() const {
+        return words + pos;
+    }
+
+    int get() {
+        if (pos >= end) {
+            ok = false;
+            return 0;
+        }
+        return words[pos++];
+    }
+
+    float getFloat() {
+        int word = get();
+        float value;
+        memcpy(&value, &word, sizeof(value));
+        return value;
+    }
+
+    // Reads a count that must be in [0, limit]
+    int getCount(int limit) {
+        int value = get();
+        if (value < 0 || value > limit) {
+            ok = false;
+            return 0;
+        }
+        return value;
+    }
+
+    void fail() {
+        ok = false;
+    }
+};
+
+// ===================== NODE POOL =====================
+// Chunked free-list allocator for fixed-size nodes. Every structure owns its
+// own pool: released nodes are recycled by the next create(), and reset()
+// forgets all nodes in O(1) while keeping the chunks for reuse. release()
+// and reset() never run destructors; nodes that own memory (strings) go
+// back through destroy().
+template <typename T>
+class NodePool {
+private:
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct Chunk {
+        Chunk* next;
+        Slot* slots;
+        int count;
+    };
+
+    static const int FIRST_CHUNK = 64;
+    static const int MAX_CHUNK = 4096;
+
+    Chunk* head;
+    Chunk* current; // chunk being carved; later chunks are spare after reset()
+    int used;       // slots carved from current
+    Slot* freeList;
+
+    Slot* carve() {
+        if (current == NULL || used == current->count) {
+            Chunk* next = (current == NULL) ? head : current->next;
+            if (next == NULL) {
+                int count = (current == NULL) ? FIRST_CHUNK : current->count * 2;
+                if (count > MAX_CHUNK) count = MAX_CHUNK;
+                next = new Chunk;
+                next->next = NULL;
+                next->slots = new Slot[count];
+                next->count = count;
+                if (current == NULL) head = next;
+                else current->next = next;
+            }
+            current = next;
+            used = 0;
+        }
+        return &current->slots[used++];
+    }
+
+    NodePool(const NodePool&);
+    NodePool& operator=(const NodePool&);
+
+public:
+    NodePool() : head(NULL), current(NULL), used(0), freeList(NULL) {}
+
+    ~NodePool() {
+        while (head) {
+            Chunk* next = head->next;
+            delete[] head->slots;
+            delete head;
+            head = next;
+        }
+    }
+
+    template <typename... Args>
+    T* create(Args... args) {
+        Slot* slot = freeList;
+        if (slot) freeList = slot->next;
+        else slot = carve();
+        return new (slot->storage) T(args...);
+    }
+
+    void release(T* node) {
+        Slot* slot = reinterpret_cast<Slot*>(node);
+        slot->next = freeList;
+        freeList = slot;
+    }
+
+    // Runs ~T, then recycles the slot like release()
+    void destroy(T* node) {
+        node->~T();
+        release(node);
+    }
+
+    void reset() {
+        current = NULL;
+        used = 0;
+        freeList = NULL;
+    }
+
+    // Frees the spare chunks after the one being carved (all of them after
+    // reset()); live nodes are never in those
+    void trim() {
+        Chunk* spare;
+        if (current == NULL) {
+            spare = head;
+            head = NULL;
+        }
+        else {
+            spare = current->next;
+            current->next = NULL;
+        }
+        while (spare) {
+            Chunk* next = spare->next;
+            delete[] spare->slots;
+            delete spare;
+            spare = next;
+        }
+    }
+
+    // Bytes held in chunks, live or free
+    size_t heapBytes() const {
+        size_t bytes = 0;
+        for (Chunk* chunk = head; chunk; chunk = chunk->next) {
+            bytes += sizeof(Chunk) + (size_t)chunk->count * sizeof(Slot);
+        }
+        return bytes;
+    }
+
+    // Exchanges all chunks and free slots with other in O(1)
+    void swap(NodePool& other) {
+        Chunk* chunk = head;
+        head = other.head;
+        other.head = chunk;
+        chunk = current;
+        current = other.current;
+        other.current = chunk;
+        int carved = used;
+        used = other.used;
+        other.used = carved;
+        Slot* slot = freeList;
+        freeList = other.freeList;
+        other.freeList = slot;
+    }
+};
+
+// ===================== CHUNKED ARENA =====================
+// Append-only array of plain T addressed by index, stored in fixed chunks:
+// elements never move while it grows, so pointers into it stay valid, and
+// truncate() rolls back to an earlier size in O(1), keeping the chunks
+// for reuse. The persistent structures allocate their nodes here.
+template <typename T>
+class ChunkedArena {
+private:
+    static const int CHUNK_BITS = 10;
+    static const int CHUNK = 1 << CHUNK_BITS;
+
+    T** chunks;
+    int chunkCount; // chunks allocated
+    int chunkCap;   // length of the chunks table
+    int count;
+
+    ChunkedArena(const ChunkedArena&);
+    ChunkedArena& operator=(const ChunkedArena&);
+
+    void addChunk() {
+        if (chunkCount == chunkCap) {
+            int newCap = (chunkCap == 0) ? 8 : chunkCap * 2;
+            T** grown = new T*[newCap];
+            for (int i = 0; i < chunkCount; i++) grown[i] = chunks[i];
+            delete[] chunks;
+            chunks = grown;
+            chunkCap = newCap;
+        }
+        chunks[chunkCount++] = new T[CHUNK];
+    }
+
+public:
+    ChunkedArena() : chunks(NULL), chunkCount(0), chunkCap(0), count(0) {}
+
+    ~ChunkedArena() {
+        for (int i = 0; i < chunkCount; i++) delete[] chunks[i];
+        delete[] chunks;
+    }
+
+    // Appends item and returns its index
+    int push(const T& item) {
+        if (count == chunkCount * CHUNK) addChunk();
+        at(count) = item;
+        return count++;
+    }
+
+    T& at(int i) {
+        return chunks[i >> CHUNK_BITS][i & (CHUNK - 1)];
+    }
+
+    const T& at(int i) const {
+        return chunks[i >> CHUNK_BITS][i & (CHUNK - 1)];
+    }
+
+    int size() const {
+        return count;
+    }
+
+    // Forgets every element from index length on
+    void truncate(int length) {
+        if (length < count) count = length;
+    }
+
+    // Frees the chunks past the current size
+    void trim() {
+        int needed = (count + CHUNK - 1) >> CHUNK_BITS;
+        while (chunkCount > needed) delete[] chunks[--chunkCount];
+    }
+
+    // Exchanges all elements with other in O(1)
+    void swap(ChunkedArena& other) {
+        T** table = chunks;
+        chunks = other.chunks;
+        other.chunks = table;
+        int value = chunkCount;
+        chunkCount = other.chunkCount;
+        other.chunkCount = value;
+        value = chunkCap;
+        chunkCap = other.chunkCap;
+        other.chunkCap = value;
+        value = count;
+        count = other.count;
+        other.count = value;
+    }
+
+    size_t heapBytes() const {
+        return (size_t)chunkCap * sizeof(T*) + (size_t)chunkCount * CHUNK * sizeof(T);
+    }
+};
+
+// ===================== LINKED LIST NODE =====================
+struct Node {
+    int data;
+    Node* next;
+
+    Node(int data) : data(data), next(NULL) {}
+};
+
+// ===================== QUEUE =====================
+class Queue {
+private:
+    Node* front;
+    Node* rear;
+    int size;
+    NodePool<Node> pool;
+
+public:
+    Queue() : front(NULL), rear(NULL), size(0) {}
+
+    void enqueue(int data) {
+        Node* newNode = pool.create(data);
+        if (rear == NULL) {
+            front = rear = newNode;
+        }
+        else {
+            rear->next = newNode;
+            rear = newNode;
+        }
+        size++;
+    }
+
+    void dequeue() {
+        if (empty())
+            return;
+        Node* temp = front;
+        front = front->next;
+        if (front == NULL) {
+            rear = NULL;
+        }
+        pool.release(temp);
+        size--;
+    }
+
+    int Front() {
+        if (empty()) 
+            return -1;
+        return front->data;
+    }
+
+    bool empty() {
+        return size == 0;
+    }
+
+    void clear() {
+        front = rear = NULL;
+        size = 0;
+        pool.reset();
+    }
+
+    size_t heapBytes() const {
+        return pool.heapBytes();
+    }
+};
+
+// ===================== STACK =====================
+class Stack {
+private:
+    Node* top;
+    int size;
+    NodePool<Node> pool;
+
+public:
+    Stack() : top(NULL), size(0) {}
+
+    void push(int data) {
+        Node* newNode = pool.create(data);
+        newNode->next = top;
+        top = newNode;
+        size++;
+    }
+
+    void pop() {
+        if (empty()) 
+            return;
+        Node* temp = top;
+        top = top->next;
+        pool.release(temp);
+        size--;
+    }
+
+    int Top() {
+        if (empty()) 
+            return -1;
+        return top->data;
+    }
+
+    bool empty() {
+        return size == 0;
+    }
+
+    void clear() {
+        top = NULL;
+        size = 0;
+        pool.reset();
+    }
+
+    size_t heapBytes() const {
+        return pool.heapBytes();
+    }
+};
+
+// ===================== INDEXED MIN HEAP (FOR PRIM/DIJKSTRA) =====================
+struct PQNode {
+    int vertex;
+    int key;
+};
+
+// 4-ary min-heap over vertex ids [0, capacity) with a position map. A vertex
+// is stored at most once, and push() on a queued vertex lowers its key in
+// place, so the heap never holds stale entries and needs O(n) memory.
+class IndexedMinHeap {
+private:
+    static const int D = 4;
+
+    PQNode* heap;
+    int* pos; // heap index of each vertex, -1 when not queued
+    int size;
+    int capacity;
+
+    void place(int i, PQNode node) {
+        heap[i] = node;
+        pos[node.vertex] = i;
+    }
+
+    void heapifyUp(int i) {
+        PQNode node = heap[i];
+        while (i > 0) {
+            int parent = (i - 1) / D;
+            if (heap[parent].key <= node.key) break;
+            place(i, heap[parent]);
+            i = parent;
+        }
+        place(i, node);
+    }
+
+    void heapifyDown(int i) {
+        PQNode node = heap[i];
+        while (true) {
+            int first = D * i + 1;
+            if (first >= size) break;
+            int last = (first + D < size) ? first + D : size;
+            int smallest = first;
+            for (int c = first + 1; c < last; c++) {
+                if (heap[c].key < heap[smallest].key) smallest = c;
+            }
+            if (heap[smallest].key >= node.key) break;
+            place(i, heap[smallest]);
+            i = smallest;
+        }
+        place(i, node);
+    }
+
+public:
+    IndexedMinHeap(int cap) : size(0), capacity(cap) {
+        heap = new PQNode[capacity > 0 ? capacity : 1];
+        pos = new int[capacity > 0 ? capacity : 1];
+        for (int i = 0; i < capacity; i++) pos[i] = -1;
+    }
+
+    ~IndexedMinHeap() {
+        delete[] heap;
+        delete[] pos;
+    }
+
+    bool contains(int vertex) {
+        return pos[vertex] != -1;
+    }
+
+    // Inserts vertex, or decreases its key if already queued with a larger
+    // one; a larger key for a queued vertex is ignored
+    void push(int vertex, int key) {
+        if (vertex < 0 || vertex >= capacity) return;
+        int i = pos[vertex];
+        if (i == -1) {
+            PQNode node = { vertex, key };
+            place(size, node);
+            size++;
+            heapifyUp(size - 1);
+        }
+        else if (key < heap[i].key) {
+            heap[i].key = key;
+            heapifyUp(i);
+        }
+    }
+
+    PQNode pop() {
+        if (size == 0) return { -1, 999999 };
+        PQNode top = heap[0];
+        pos[top.vertex] = -1;
+        size--;
+        if (size > 0) {
+            place(0, heap[size]);
+            heapifyDown(0);
+        }
+        return top;
+    }
+
+    bool empty() {
+        return size == 0;
+    }
+
+    // Smallest queued key, 999999 when empty
+    int minKey() {
+        return (size == 0) ? 999999 : heap[0].key;
+    }
+
+    int getCapacity() {
+        return capacity;
+    }
+
+    // Empties the heap in O(size), leaving the position map reusable
+    void clear() {
+        for (int i = 0; i < size; i++) pos[heap[i].vertex] = -1;
+        size = 0;
+    }
+
+    size_t heapBytes() const {
+        size_t slots = capacity > 0 ? capacity : 1;
+        return slots * (sizeof(PQNode) + sizeof(int));
+    }
+};
+
+// One side of a point-to-point search: tentative distances, predecessors
+// and the open set. Entries count only while their stamp matches epoch,
+// so reset() is O(1) and a query pays for the vertices it reaches, not n.
+class SearchFrontier {
+private:
+    int capacity;
+    int* dist;
+    int* parent;
+    int* reachedAt; // epoch in which dist/parent were written
+    int* closedAt;  // epoch in which the vertex was settled
+    int epoch;
+
+    SearchFrontier(const SearchFrontier&);
+    SearchFrontier& operator=(const SearchFrontier&);
+
+public:
+    IndexedMinHeap open;
+
+    SearchFrontier(int cap) : capacity(cap > 0 ? cap : 1), epoch(1), open(cap > 0 ? cap : 1) {
+        dist = new int[capacity];
+        parent = new int[capacity];
+        reachedAt = new int[capacity];
+        closedAt = new int[capacity];
+        for (int i = 0; i < capacity; i++) reachedAt[i] = closedAt[i] = 0;
+    }
+
+    ~SearchFrontier() {
+        delete[] dist;
+        delete[] parent;
+        delete[] reachedAt;
+        delete[] closedAt;
+    }
+
+    int getCapacity() {
+        return capacity;
+    }
+
+    size_t heapBytes() const {
+        return (size_t)capacity * 4 * sizeof(int) + open.heapBytes();
+    }
+
+    void reset() {
+        open.clear();
+        if (++epoch == 2147483647) {
+            for (int i = 0; i < capacity; i++) reachedAt[i] = closedAt[i] = 0;
+            epoch = 1;
+        }
+    }
+
+    int distance(int v) {
+        return (reachedAt[v] == epoch) ? dist[v] : 999999;
+    }
+
+    int parentOf(int v) {
+        return (reachedAt[v] == epoch) ? parent[v] : -1;
+    }
+
+    bool isClosed(int v) {
+        return closedAt[v] == epoch;
+    }
+
+    void close(int v) {
+        closedAt[v] = epoch;
+    }
+
+    // Records d (via from) if it beats v's current distance
+    bool improve(int v, int d, int from) {
+        if (d >= distance(v)) return false;
+        dist[v] = d;
+        parent[v] = from;
+        reachedAt[v] = epoch;
+        return true;
+    }
+};
+
+// ===================== 1. BINARY HEAP =====================
+// Orders the heap core is instantiated with, so the sift loops carry no
+// runtime min/max test
+struct MinOrder {
+    static bool before(int a, int b) {
+        return a < b;
+    }
+};
+
+struct MaxOrder {
+    static bool before(int a, int b) {
+        return a > b;
+    }
+};
+
+// Sift loops of an implicit D-ary heap. Nodes are numbered level by level
+// from 0 and the children of i are D*i+1 .. D*i+D; `a` points at node 0.
+// The moving value stays in a register and is stored once at the end;
+// the trace still reports each step as a swap of node numbers.
+template <int D, typename Order>
+struct HeapCore {
+    static void siftUp(int* a, int size, int i, TraceBuffer& trace, OpCounters& counters) {
+        (void)size;
+        int value = a[i];
+        while (i > 0) {
+            int parent = (i - 1) / D;
+            int above = a[parent];
+            bool up = Order::before(value, above);
+            counters.add(COUNT_COMPARE);
+            trace.record(TRACE_COMPARE, i, parent, up ? 1 : 0);
+            if (!up)
+                break;
+            a[i] = above;
+            counters.add(COUNT_SWAP);
+            trace.record(TRACE_SWAP, i, parent, 0);
+            i = parent;
+        }
+        a[i] = value;
+    }
+
+    static void siftDown(int* a, int size, int i, TraceBuffer& trace, OpCounters& counters) {
+        int value = a[i];
+        while (true) {
+            int first = D * i + 1;
+            if (first >= size)
+                break;
+            int last = (size - first < D) ? size : first + D;
+
+            int target = i;
+            int best = value;
+            for (int c = first; c < last; c++) {
+                int before = target;
+                int child = a[c];
+                if (Order::before(child, best)) {
+                    target = c;
+                    best = child;
+                }
+                counters.add(COUNT_COMPARE);
+                trace.record(TRACE_COMPARE, c, before, target == c ? 1 : 0);
+            }
+
+            if (target == i)
+                break;
+            a[i] = best;
+            counters.add(COUNT_SWAP);
+            trace.record(TRACE_SWAP, i, target, 0);
+            i = target;
+        }
+        a[i] = value;
+    }
+
+    // Floyd's O(n) heapify, last internal node first
+    static void build(int* a, int size, int i, TraceBuffer& trace, OpCounters& counters) {
+        (void)i;
+        if (size < 2)
+            return;
+        for (int v = (size - 2) / D; v >= 0; v--) siftDown(a, size, v, trace, counters);
+    }
+};
+
+// Array-backed heap of arity 2 (default, what the page draws), 4 or 8.
+// Node 0 sits D-1 ints into a 64-byte aligned block, so each sibling group
+// starts on a multiple of D ints and a 4-ary sift reads one cache line per
+// level. Min/max and arity pick a HeapCore instantiation once, in
+// selectCore(), instead of branching on every comparison.
+class BinaryHeap {
+private:
+    typedef void (*SiftFn)(int* a, int size, int i, TraceBuffer& trace, OpCounters& counters);
+
+    static const int MAX_ARITY = 8;
+    static const int ALIGN_INTS = 16; // 64 bytes
+
+    int* block; // allocation; arr is aligned inside it
+    int* arr;   // node 0
+    int size;
+    int cap;
+    int arity;
+    bool isMin;
+    SiftFn up;
+    SiftFn down;
+    SiftFn buildAll;
+    TraceBuffer trace;
+    OpCounters counters;
+    IntBuffer snapshot;
+
+    BinaryHeap(const BinaryHeap&);
+    BinaryHeap& operator=(const BinaryHeap&);
+
+    template <int D>
+    void selectFor() {
+        if (isMin) {
+            up = &HeapCore<D, MinOrder>::siftUp;
+            down = &HeapCore<D, MinOrder>::siftDown;
+            buildAll = &HeapCore<D, MinOrder>::build;
+        }
+        else {
+            up = &HeapCore<D, MaxOrder>::siftUp;
+            down = &HeapCore<D, MaxOrder>::siftDown;
+            buildAll = &HeapCore<D, MaxOrder>::build;
+        }
+    }
+
+    void selectCore() {
+        if (arity == 4) selectFor<4>();
+        else if (arity == 8) selectFor<8>();
+        else selectFor<2>();
+    }
+
+    static int validArity(int d) {
+        return (d == 4 || d == 8) ? d : 2;
+    }
+
+    // Node 0 of a block laid out for arity d
+    static int* nodeZero(int* raw, int d) {
+        uintptr_t base = ((uintptr_t)raw + ALIGN_INTS * sizeof(int) - 1) &
+            ~(uintptr_t)(ALIGN_INTS * sizeof(int) - 1);
+        return (int*)base + (d - 1);
+    }
+
+    // Room for capacity values after node 0 at any arity and alignment
+    static int* allocBlock(int capacity) {
+        return new int[capacity + MAX_ARITY - 1 + ALIGN_INTS];
+    }
+
+    void buildHeap() {
+        buildAll(arr, size, 0, trace, counters);
+    }
+
+public:
+    BinaryHeap(bool minHeap = true, int initialCapacity = 100, int heapArity = 2)
+        : size(0), cap(initialCapacity > 0 ? initialCapacity : 1),
+        arity(validArity(heapArity)), isMin(minHeap) {
+        block = allocBlock(cap);
+        arr = nodeZero(block, arity);
+        selectCore();
+    }
+
+    ~BinaryHeap() {
+        delete[] block;
+    }
+
+    // Grows the array geometrically until it holds at least minCap values
+    void reserve(int minCap) {
+        if (minCap <= cap)
+            return;
+        int newCap = cap;
+        while (newCap < minCap) newCap *= 2;
+        int* grown = allocBlock(newCap);
+        int* moved = nodeZero(grown, arity);
+        for (int i = 0; i < size; i++) moved[i] = arr[i];
+        delete[] block;
+        block = grown;
+        arr = moved;
+        cap = newCap;
+    }
+
+    void insert(int val) {
+        if (size == cap)
+            reserve(cap + 1);
+        arr[size] = val;
+        size++;
+        up(arr, size, size - 1, trace, counters);
+    }
+
+    // Replaces the contents with values and heapifies in O(n)
+    void buildFrom(const int* values, int count) {
+        size = 0;
+        bulkInsert(values, count);
+    }
+
+    // Appends values, then restores the heap with one O(n) buildHeap when
+    // the batch is large compared with the heap, else by sifting each up
+    void bulkInsert(const int* values, int count) {
+        if (count <= 0)
+            return;
+        reserve(size + count);
+        int oldSize = size;
+        for (int i = 0; i < count; i++) arr[size + i] = values[i];
+        size += count;
+        if (count * 8 >= oldSize) {
+            buildHeap();
+        }
+        else {
+            for (int i = oldSize; i < size; i++) up(arr, size, i, trace, counters);
+        }
+    }
+
+    int getCapacity() {
+        return cap;
+    }
+
+    // Bytes owned by the heap: the object, the value block and the trace,
+    // counter and snapshot buffers
+    size_t memoryUsage() const {
+        return sizeof(*this) +
+            (size_t)(cap + MAX_ARITY - 1 + ALIGN_INTS) * sizeof(int) +
+            trace.heapBytes() + counters.heapBytes() + snapshot.heapBytes();
+    }
+
+    // Reallocates the value block to the current size and frees the
+    // exported buffers; the next insert grows it geometrically again
+    void shrinkToFit() {
+        int newCap = size > 0 ? size : 1;
+        if (newCap < cap) {
+            int* fitted = allocBlock(newCap);
+            int* moved = nodeZero(fitted, arity);
+            for (int i = 0; i < size; i++) moved[i] = arr[i];
+            delete[] block;
+            block = fitted;
+            arr = moved;
+            cap = newCap;
+        }
+        trace.shrink();
+        counters.shrink();
+        snapshot.release();
+    }
+
+    int extractTop() {
+        if (size == 0) 
+            return -999999;
+        int root = arr[0];
+        size--;
+        arr[0] = arr[size];
+        if (size > 0) down(arr, size, 0, trace, counters);
+        return root;
+    }
+
+    void convertToMinHeap() {
+        isMin = true;
+        selectCore();
+        buildHeap();
+    }
+
+    void convertToMaxHeap() {
+        isMin = false;
+        selectCore();
+        buildHeap();
+    }
+
+    bool getIsMinHeap() {
+        return isMin;
+    }
+
+    int getArity() {
+        return arity;
+    }
+
+    // Relayouts the values for arity 2, 4 or 8 (anything else means 2)
+    // and rebuilds the heap in O(n)
+    void setArity(int heapArity) {
+        int d = validArity(heapArity);
+        if (d == arity)
+            return;
+        int* moved = nodeZero(block, d); // at most 6 ints from arr
+        if (moved < arr) {
+            for (int i = 0; i < size; i++) moved[i] = arr[i];
+        }
+        else {
+            for (int i = size - 1; i >= 0; i--) moved[i] = arr[i];
+        }
+        arr = moved;
+        arity = d;
+        selectCore();
+        buildHeap();
+    }
+
+    string getArray() {
+        return formatList(arr, size);
+    }
+
+    // Snapshot (see SNAPSHOTS) payload: isMin, arity, size, then the
+    // values in level order
+    IntBuffer& serialize() {
+        SnapshotWriter out(snapshot, SNAPSHOT_HEAP);
+        out.put(isMin ? 1 : 0);
+        out.put(arity);
+        out.put(size);
+        for (int i = 0; i < size; i++) out.put(arr[i]);
+        return out.finish();
+    }
+
+    // Restores a serialize() result; the values are re-heapified in O(n),
+    // which moves nothing when they came from a heap of the same order
+    bool deserialize(const int* words, int length) {
+        SnapshotReader in(words, length, SNAPSHOT_HEAP);
+        bool minHeap = in.get() != 0;
+        int d = in.get();
+        int count = in.getCount(in.remaining());
+        if (!in.valid() || d != validArity(d) || in.remaining() != count)
+            return false;
+
+        size = 0;
+        isMin = minHeap;
+        arity = d;
+        arr = nodeZero(block, arity);
+        selectCore();
+        buildFrom(words + length - 1 - count, count);
+        return true;
+    }
+
+    // Level-order heap contents, aliased directly (no copy)
+    const int* data() {
+        return arr;
+    }
+
+    int getSize() {
+        return size;
+    }
+
+    void clear() {
+        size = 0;
+    }
+
+    // Step tracing (see TRACE BUFFER); capacity in events, 0 turns it off
+    void enableTrace(int capacity) {
+        trace.enable(capacity);
+    }
+
+    void disableTrace() {
+        trace.disable();
+    }
+
+    void clearTrace() {
+        trace.clear();
+    }
+
+    int getTraceDropped() {
+        return trace.getDropped();
+    }
+
+    IntBuffer& exportTrace() {
+        return trace.exportEvents();
+    }
+
+    // Work totals (see OP COUNTERS)
+    void resetCounters() {
+        counters.reset();
+    }
+
+    IntBuffer& exportCounters() {
+        return counters.exportValues();
+    }
+};
+
+// Timeline of a binary heap for scrubbing through its operations. Every
+// insert, extractTop, build, conversion or clear that changes the heap
+// seals a new version, and checkout() or getArrayAt() reach any version
+// in O(1). The level-order array is a persistent 16-way trie of blocks:
+// an operation copies only the blocks its sift writes to, once each, with
+// the branch blocks above them, and shares the rest with older versions.
+// Changing an older checked-out version discards the versions after it
+// and recycles their blocks, like an undo history.
+class PersistentHeap {
+private:
+    static const int BITS = 4;
+    static const int WIDTH = 1 << BITS; // ints per block, one cache line
+    // Branch levels that cover every int index (16^8 = 2^32)
+    static const int MAX_LEVELS = 7;
+
+    struct Block {
+        int stamp;        // version whose operation wrote it
+        int slot[WIDTH];  // values in a leaf, child blocks (-1 none) in a branch
+    };
+
+    struct Version {
+        int root;   // block, -1 when nothing was written yet
+        int levels; // branch levels above the leaves
+        int size;
+        int blocks; // arena size once sealed; later blocks are newer versions'
+        bool isMin;
+    };
+
+    ChunkedArena<Block> blocks;
+    ChunkedArena<Version> versions;
+    int current; // checked-out version
+    Version work; // the version the running operation builds
+    IntBuffer output;
+
+    PersistentHeap(const PersistentHeap&);
+    PersistentHeap& operator=(const PersistentHeap&);
+
+    // Builds on the checked-out version; newer ones and their blocks go
+    void begin() {
+        versions.truncate(current + 1);
+        work = versions.at(current);
+        blocks.truncate(work.blocks);
+    }
+
+    void commit() {
+        work.blocks = blocks.size();
+        current = versions.push(work);
+    }
+
+    // b if the running operation wrote it already, else a copy of b (an
+    // empty block for -1) that it may write
+    int own(int b) {
+        int stamp = current + 1;
+        if (b != -1 && blocks.at(b).stamp == stamp) return b;
+        Block copy;
+        if (b == -1) {
+            for (int i = 0; i < WIDTH; i++) copy.slot[i] = -1;
+        }
+        else {
+            copy = blocks.at(b);
+        }
+        copy.stamp = stamp;
+        return blocks.push(copy);
+    }
+
+    int read(const Version& v, int i) const {
+        int b = v.root;
+        for (int level = v.levels; level > 0; level--) {
+            b = blocks.at(b).slot[(i >> (level * BITS)) & (WIDTH - 1)];
+        }
+        return blocks.at(b).slot[i & (WIDTH - 1)];
+    }
+
+    // Path copy of the trie down to index i of work
+    void write(int i, int value) {
+        while (work.levels < MAX_LEVELS && (i >> (BITS * (work.levels + 1))) != 0) {
+            int top = own(-1);
+            blocks.at(top).slot[0] = work.root;
+            work.root = top;
+            work.levels++;
+        }
+        work.root = own(work.root);
+        int b = work.root;
+        for (int level = work.levels; level > 0; level--) {
+            int* link = &blocks.at(b).slot[(i >> (level * BITS)) & (WIDTH - 1)];
+            *link = own(*link); // arena pushes never move blocks
+            b = *link;
+        }
+        blocks.at(b).slot[i & (WIDTH - 1)] = value;
+    }
+
+    bool before(int a, int b) const {
+        return work.isMin ? a < b : a > b;
+    }
+
+    void siftUp(int i) {
+        int value = read(work, i);
+        while (i > 0) {
+            int parent = (i - 1) / 2;
+            int above = read(work, parent);
+            if (!before(value, above))
+                break;
+            write(i, above);
+            i = parent;
+        }
+        write(i, value);
+    }
+
+    void siftDown(int i) {
+        int value = read(work, i);
+        while (true) {
+            int child = 2 * i + 1;
+            if (child >= work.size)
+                break;
+            int best = read(work, child);
+            if (child + 1 < work.size) {
+                int right = read(work, child + 1);
+                if (before(right, best)) {
+                    child++;
+                    best = right;
+                }
+            }
+            if (!before(best, value))
+                break;
+            write(i, best);
+            i = child;
+        }
+        write(i, value);
+    }
+
+    void heapify() {
+        for (int v = (work.size - 2) / 2; v >= 0; v--) siftDown(v);
+    }
+
+    void convert(bool minHeap) {
+        if (versions.at(current).isMin == minHeap)
+            return;
+        begin();
+        work.isMin = minHeap;
+        heapify();
+        commit();
+    }
+
+public:
+    PersistentHeap(bool minHeap = true) : current(0) {
+        Version empty = { -1, 0, 0, 0, minHeap };
+        versions.push(empty);
+    }
+
+    void insert(int val) {
+        begin();
+        write(work.size, val);
+        work.size++;
+        siftUp(work.size - 1);
+        commit();
+    }
+
+    // -999999 (and no new version) when empty
+    int extractTop() {
+        if (versions.at(current).size == 0)
+            return -999999;
+        begin();
+        int top = read(work, 0);
+        work.size--;
+        if (work.size > 0) {
+            write(0, read(work, work.size));
+            siftDown(0);
+        }
+        commit();
+        return top;
+    }
+
+    // Replaces the contents with values, heapified in O(n), as one version
+    void buildFrom(const int* values, int count) {
+        begin();
+        work.root = -1;
+        work.levels = 0;
+        work.size = (count > 0) ? count : 0;
+        for (int i = 0; i < work.size; i++) write(i, values[i]);
+        heapify();
+        commit();
+    }
+
+    void convertToMinHeap() {
+        convert(true);
+    }
+
+    void convertToMaxHeap() {
+        convert(false);
+    }
+
+    void clear() {
+        if (versions.at(current).size == 0)
+            return;
+        begin();
+        work.root = -1;
+        work.levels = 0;
+        work.size = 0;
+        commit();
+    }
+
+    // Version 0 is the empty heap this one started as
+    int getVersion() {
+        return current;
+    }
+
+    int getVersionCount() {
+        return versions.size();
+    }
+
+    // Makes version the current one in O(1); false if there is none
+    bool checkout(int version) {
+        if (version < 0 || version >= versions.size())
+            return false;
+        current = version;
+        return true;
+    }
+
+    int getSize() {
+        return versions.at(current).size;
+    }
+
+    int getSizeAt(int version) {
+        if (version < 0 || version >= versions.size())
+            return 0;
+        return versions.at(version).size;
+    }
+
+    bool getIsMinHeap() {
+        return versions.at(current).isMin;
+    }
+
+    // Level-order contents of version (empty if there is none), read a
+    // block at a time
+    IntBuffer& exportArrayAt(int version) {
+        output.clear();
+        if (version < 0 || version >= versions.size())
+            return output;
+        const Version& v = versions.at(version);
+        output.reserve(v.size);
+        for (int i = 0; i < v.size; i += WIDTH) {
+            int b = v.root;
+            for (int level = v.levels; level > 0; level--) {
+                b = blocks.at(b).slot[(i >> (level * BITS)) & (WIDTH - 1)];
+            }
+            const int* leaf = blocks.at(b).slot;
+            int end = (v.size - i < WIDTH) ? v.size - i : WIDTH;
+            for (int k = 0; k < end; k++) output.data[output.size++] = leaf[k];
+        }
+        return output;
+    }
+
+    string getArray() {
+        return formatList(exportArrayAt(current));
+    }
+
+    string getArrayAt(int version) {
+        return formatList(exportArrayAt(version));
+    }
+
+    // Keeps only the current version, renumbered 0, in fresh blocks
+    void discardHistory() {
+        bool minHeap = versions.at(current).isMin;
+        exportArrayAt(current);
+        ChunkedArena<Block> old;
+        old.swap(blocks);
+        versions.truncate(0);
+        versions.trim();
+        current = -1;
+        Version start = { -1, 0, output.size, 0, minHeap };
+        work = start;
+        for (int i = 0; i < output.size; i++) write(i, output.data[i]);
+        commit();
+    }
+
+    // Bytes owned by the timeline: the object, every block of every
+    // version, the version table and the export buffer
+    size_t memoryUsage() const {
+        return sizeof(*this) + blocks.heapBytes() + versions.heapBytes() + output.heapBytes();
+    }
+
+    // Frees arena chunks left spare by discarded versions
+    void shrinkToFit() {
+        blocks.trim();
+        versions.trim();
+        output.release();
+    }
+};
+
+// ===================== 2. AVL TREE =====================
+class AVLTree {
+private:
+    struct Node {
+        int key;
+        int height;
+        int size; // nodes in this subtree, for rank / select
+        Node* left;
+        Node* right;
+
+        Node(int k) {
+            key = k;
+            height = 1;
+            size = 1;
+            left = right = 0;
+            right = 0;
+        }
+    };
+
+    Node* root;
+    NodePool<Node> pool;
+    int count;
+    string lastRotation;
+    IntBuffer changed; // keys touched by the last operation, bottom-up
+    IntBuffer output;
+    TraceBuffer trace;
+    OpCounters counters;
+    IntBuffer snapshot;
+
+    // own max function
+    int max(int a, int b) {
+        return (a > b) ? a : b;
+    }
+
+    int height(Node* n) {
+        return (n == 0) ? 0 : n->height;
+    }
+
+    int getBalance(Node* n) {
+        if (n == 0) return 0;
+        return height(n->left) - height(n->right);
+    }
+
+    int sizeOf(Node* n) {
+        return (n == 0) ? 0 : n->size;
+    }
+
+    void updateSize(Node* n) {
+        n->size = 1 + sizeOf(n->left) + sizeOf(n->right);
+    }
+
+    // Right rotation (LL)
+    Node* rightRotate(Node* y) {
+        Node* x = y->left;
+        Node* T2 = x->right;
+
+        x->right = y;
+        y->left = T2;
+
+        y->height = 1 + max(height(y->left), height(y->right));
+        x->height = 1 + max(height(x->left), height(x->right));
+        updateSize(y);
+        updateSize(x);
+
+        changed.push(y->key);
+        changed.push(x->key);
+        counters.add(COUNT_ROTATE);
+        trace.record(TRACE_ROTATE, y->key, x->key, 0);
+        return x;
+    }
+
+    // Left rotation (RR)
+    Node* leftRotate(Node* x) {
+        Node* y = x->right;
+        Node* T2 = y->left;
+
+        y->left = x;
+        x->right = T2;
+
+        x->height = 1 + max(height(x->left), height(x->right));
+        y->height = 1 + max(height(y->left), height(y->right));
+        updateSize(x);
+        updateSize(y);
+
+        changed.push(x->key);
+        changed.push(y->key);
+        counters.add(COUNT_ROTATE);
+        trace.record(TRACE_ROTATE, x->key, y->key, 1);
+        return y;
+    }
+
+    // AVL height is below 1.45 * log2(n + 2), i.e. under 47 for any int
+    // count of nodes, so a fixed path always fits
+    static const int MAX_PATH = 64;
+
+    // Restores the AVL property at node, whose children are balanced, and
+    // returns the new subtree root
+    Node* rebalance(Node* node) {
+        node->height = 1 + max(height(node->left), height(node->right));
+        updateSize(node);
+        int balance = getBalance(node);
+
+        // LL
+        if (balance > 1 && getBalance(node->left) >= 0) {
+            lastRotation = "LL";
+            return rightRotate(node);
+        }
+
+        // LR
+        if (balance > 1) {
+            lastRotation = "LR";
+            node->left = leftRotate(node->left);
+            return rightRotate(node);
+        }
+
+        // RR
+        if (balance < -1 && getBalance(node->right) <= 0) {
+            lastRotation = "RR";
+            return leftRotate(node);
+        }
+
+        // RL
+        if (balance < -1) {
+            lastRotation = "RL";
+            node->right = rightRotate(node->right);
+            return leftRotate(node);
+        }
+
+        return node;
+    }
+
+    // Walks path (links from the root down) bottom-up, rebalancing each
+    // node. Rebalancing stops as soon as a subtree keeps its old height,
+    // since no balance above it can have changed; the ancestors only get
+    // their sizes fixed. Every rebalanced node goes into changed, so its
+    // last entry is the root of the smallest subtree that changed.
+    // The walk may only stop once it has reached path[floor].
+    void retrace(Node** path[], int depth, int floor) {
+        int i = depth - 1;
+        for (; i >= 0; i--) {
+            Node* node = *path[i];
+            int oldHeight = node->height;
+            Node* top = rebalance(node);
+            *path[i] = top;
+            changed.push(top->key);
+            if (i <= floor && top == node && top->height == oldHeight)
+                break;
+        }
+        for (i--; i >= 0; i--) updateSize(*path[i]);
+    }
+
+    // Iterative insert: no recursion, no allocation beyond the new node
+    void insertKey(int key) {
+        Node** path[MAX_PATH];
+        int depth = 0;
+        Node** link = &root;
+
+        while (*link != 0) {
+            Node* node = *link;
+            counters.add(COUNT_COMPARE);
+            trace.record(TRACE_COMPARE, key, node->key,
+                key == node->key ? 0 : (key < node->key ? -1 : 1));
+            if (key == node->key)
+                return; // duplicates not allowed
+            path[depth++] = link;
+            link = (key < node->key) ? &node->left : &node->right;
+        }
+
+        *link = pool.create(key);
+        count++;
+        changed.push(key);
+        retrace(path, depth, depth);
+    }
+
+    void removeKey(int key) {
+        Node** path[MAX_PATH];
+        int depth = 0;
+        Node** link = &root;
+
+        while (*link != 0 && (*link)->key != key) {
+            counters.add(COUNT_COMPARE);
+            trace.record(TRACE_COMPARE, key, (*link)->key, key < (*link)->key ? -1 : 1);
+            path[depth++] = link;
+            link = (key < (*link)->key) ? &(*link)->left : &(*link)->right;
+        }
+        if (*link == 0)
+            return;
+        counters.add(COUNT_COMPARE);
+        trace.record(TRACE_COMPARE, key, key, 0);
+
+        Node* target = *link;
+        int floor = depth;
+        if (target->left != 0 && target->right != 0) {
+            // Two children: take the inorder successor's key, then unlink
+            // the successor, which has no left child. The target's key
+            // changes, so the retrace must reach its parent.
+            floor = (depth > 0) ? depth - 1 : 0;
+            path[depth++] = link;
+            Node** succLink = &target->right;
+            while ((*succLink)->left != 0) {
+                path[depth++] = succLink;
+                succLink = &(*succLink)->left;
+            }
+            Node* succ = *succLink;
+            target->key = succ->key;
+            *succLink = succ->right;
+            pool.release(succ);
+            changed.push(target->key);
+        }
+        else {
+            *link = (target->left != 0) ? target->left : target->right;
+            pool.release(target);
+            if (depth == 0 && root != 0) changed.push(root->key);
+        }
+
+        count--;
+        retrace(path, depth, floor);
+    }
+
+    struct ExportFrame {
+        Node* node;
+        int parentRecord;
+        int slot; // 2 = left, 3 = right within the parent's record
+    };
+
+    // Preorder records of (key, height, left index, right index) with -1
+    // for a missing child, indices counting records from the first one
+    void exportSubtree(Node* top) {
+        output.clear();
+        if (top == 0) return;
+
+        ExportFrame stack[MAX_PATH * 2];
+        int sp = 0;
+        stack[sp].node = top;
+        stack[sp].parentRecord = -1;
+        stack[sp].slot = 0;
+        sp++;
+
+        while (sp > 0) {
+            ExportFrame frame = stack[--sp];
+            int record = output.size / 4;
+            if (frame.parentRecord != -1) {
+                output.data[frame.parentRecord * 4 + frame.slot] = record;
+            }
+            output.push(frame.node->key);
+            output.push(frame.node->height);
+            output.push(-1);
+            output.push(-1);
+
+            // Right first so the left subtree is emitted next
+            if (frame.node->right) {
+                stack[sp].node = frame.node->right;
+                stack[sp].parentRecord = record;
+                stack[sp].slot = 3;
+                sp++;
+            }
+            if (frame.node->left) {
+                stack[sp].node = frame.node->left;
+                stack[sp].parentRecord = record;
+                stack[sp].slot = 2;
+                sp++;
+            }
+        }
+    }
+
+    Node* find(int key) {
+        Node* cur = root;
+        while (cur != 0 && cur->key != key) {
+            counters.add(COUNT_COMPARE);
+            trace.record(TRACE_COMPARE, key, cur->key, key < cur->key ? -1 : 1);
+            cur = (key < cur->key) ? cur->left : cur->right;
+        }
+        if (cur != 0) {
+            counters.add(COUNT_COMPARE);
+            trace.record(TRACE_COMPARE, key, key, 0);
+        }
+        return cur;
+    }
+
+    void beginOperation() {
+        lastRotation = "";
+        changed.clear();
+    }
+
+    // Sets n's children and recomputes its height and size
+    Node* attach(Node* n, Node* left, Node* right) {
+        n->left = left;
+        n->right = right;
+        n->height = 1 + max(height(left), height(right));
+        updateSize(n);
+        return n;
+    }
+
+    // Perfectly balanced tree over keys[lo..hi); depth is log2 of the count
+    Node* buildBalanced(const int* keys, int lo, int hi) {
+        if (lo >= hi) return 0;
+        int mid = lo + (hi - lo) / 2;
+        Node* n = pool.create(keys[mid]);
+        return attach(n, buildBalanced(keys, lo, mid), buildBalanced(keys, mid + 1, hi));
+    }
+
+    // Copy of a subtree from another tree's pool into this one
+    Node* cloneSubtree(Node* n) {
+        if (n == 0) return 0;
+        Node* copy = pool.create(n->key);
+        return attach(copy, cloneSubtree(n->left), cloneSubtree(n->right));
+    }
+
+    // join(): every key of left < mid->key < every key of right. Goes down
+    // the spine of the taller side to a subtree at most one level taller
+    // than the other, hangs mid there, and rebalances on the way back up;
+    // O(|height difference| + 1).
+    Node* joinRight(Node* left, Node* mid, Node* right) {
+        if (height(left->right) <= height(right) + 1) {
+            left->right = attach(mid, left->right, right);
+        }
+        else {
+            left->right = joinRight(left->right, mid, right);
+        }
+        return rebalance(left);
+    }
+
+    Node* joinLeft(Node* left, Node* mid, Node* right) {
+        if (height(right->left) <= height(left) + 1) {
+            right->left = attach(mid, left, right->left);
+        }
+        else {
+            right->left = joinLeft(left, mid, right->left);
+        }
+        return rebalance(right);
+    }
+
+    Node* join(Node* left, Node* mid, Node* right) {
+        if (height(left) > height(right) + 1) return joinRight(left, mid, right);
+        if (height(right) > height(left) + 1) return joinLeft(left, mid, right);
+        return attach(mid, left, right);
+    }
+
+    // Splits t into the keys below and above key; the node holding key,
+    // if any, comes back in found, detached
+    void split(Node* t, int key, Node*& below, Node*& found, Node*& above) {
+        if (t == 0) {
+            below = found = above = 0;
+            return;
+        }
+        counters.add(COUNT_COMPARE);
+        Node* left = t->left;
+        Node* right = t->right;
+        if (key == t->key) {
+            below = left;
+            above = right;
+            found = t;
+        }
+        else if (key < t->key) {
+            Node* rest;
+            split(left, key, below, found, rest);
+            above = join(rest, t, right);
+        }
+        else {
+            Node* rest;
+            split(right, key, rest, found, above);
+            below = join(left, t, rest);
+        }
+    }
+
+    // Union by splitting b around a's root; nodes of b that duplicate a
+    // key are released. Both trees must use this pool.
+    Node* unite(Node* a, Node* b) {
+        if (a == 0) return b;
+        if (b == 0) return a;
+        Node* below;
+        Node* found;
+        Node* above;
+        split(b, a->key, below, found, above);
+        if (found != 0) pool.release(found);
+        Node* left = unite(a->left, below);
+        Node* right = unite(a->right, above);
+        return join(left, a, right);
+    }
+
+    // Rebuilds the subtree whose preorder keys come next in `in`, taking
+    // keys in (lo, hi) only. Clears ok on an unbalanced shape or a path
+    // deeper than any AVL tree can have.
+    Node* fromPreorder(SnapshotReader& in, long long lo, long long hi, int depth, bool& ok) {
+        if (!ok || in.atEnd()) return 0;
+        long long key = in.peek();
+        if (key <= lo || key >= hi) return 0;
+        if (depth == MAX_PATH) {
+            ok = false;
+            return 0;
+        }
+        Node* n = pool.create(in.get());
+        Node* left = fromPreorder(in, lo, key, depth + 1, ok);
+        Node* right = fromPreorder(in, key, hi, depth + 1, ok);
+        if (!ok) return 0;
+        attach(n, left, right);
+        int balance = getBalance(n);
+        if (balance > 1 || balance < -1) ok = false;
+        return n;
+    }
+
+    // Keys below key (or up to it when inclusive), one root-to-leaf walk
+    int countBelow(int key, bool inclusive) {
+        int result = 0;
+        Node* cur = root;
+        while (cur != 0) {
+            counters.add(COUNT_COMPARE);
+            if (cur->key < key || (inclusive && cur->key == key)) {
+                result += 1 + sizeOf(cur->left);
+                cur = cur->right;
+            }
+            else {
+                cur = cur->left;
+            }
+        }
+        return result;
+    }
+
+    // Appends the keys in [lo, hi] in order: the descent skips subtrees
+    // entirely outside the range, so the cost is O(log n + output)
+    void collectRange(int lo, int hi) {
+        Node* stack[MAX_PATH];
+        int sp = 0;
+        Node* cur = root;
+        while (cur != 0 || sp > 0) {
+            while (cur != 0) {
+                counters.add(COUNT_COMPARE);
+                if (cur->key < lo) {
+                    cur = cur->right;
+                }
+                else {
+                    stack[sp++] = cur;
+                    cur = cur->left;
+                }
+            }
+            if (sp == 0) break;
+            Node* node = stack[--sp];
+            if (node->key > hi) break;
+            output.push(node->key);
+            cur = node->right;
+        }
+    }
+
+public:
+    AVLTree() : root(0), count(0) {}
+
+    void insert(int key) {
+        beginOperation();
+        insertKey(key);
+    }
+
+    void remove(int key) {
+        beginOperation();
+        removeKey(key);
+    }
+
+    // Batches report the union of the changes of every key in them
+    void insertMany(const int* keys, int length) {
+        beginOperation();
+        for (int i = 0; i < length; i++) insertKey(keys[i]);
+    }
+
+    void removeMany(const int* keys, int length) {
+        beginOperation();
+        for (int i = 0; i < length; i++) removeKey(keys[i]);
+    }
+
+    // Replaces the contents with keys, which must be ascending (repeats
+    // are skipped), as a perfectly balanced tree in O(n). Returns false
+    // and leaves the tree alone when they are not sorted.
+    bool buildFromSorted(const int* keys, int length) {
+        for (int i = 1; i < length; i++) {
+            if (keys[i] < keys[i - 1]) return false;
+        }
+        clear();
+
+        output.clear();
+        output.reserve(length);
+        for (int i = 0; i < length; i++) {
+            if (i == 0 || keys[i] != keys[i - 1]) output.data[output.size++] = keys[i];
+        }
+        root = buildBalanced(output.data, 0, output.size);
+        count = output.size;
+        output.clear();
+        return true;
+    }
+
+    // Snapshot (see SNAPSHOTS) payload: count, then the keys in preorder,
+    // which pins down the exact shape
+    IntBuffer& serialize() {
+        SnapshotWriter out(snapshot, SNAPSHOT_AVL);
+        out.put(count);
+        Node* stack[MAX_PATH];
+        int sp = 0;
+        if (root != 0) stack[sp++] = root;
+        while (sp > 0) {
+            Node* node = stack[--sp];
+            out.put(node->key);
+            if (node->right) stack[sp++] = node->right;
+            if (node->left) stack[sp++] = node->left;
+        }
+        return out.finish();
+    }
+
+    // Restores a serialize() result in O(n), shape and heights included.
+    // The tree is built in a scratch tree and swapped in once it checks
+    // out, so a rejected snapshot leaves this one as it was.
+    bool deserialize(const int* words, int length) {
+        SnapshotReader in(words, length, SNAPSHOT_AVL);
+        int keys = in.getCount(in.remaining());
+        if (!in.valid() || in.remaining() != keys)
+            return false;
+
+        AVLTree staged;
+        bool ok = true;
+        staged.root = staged.fromPreorder(in, -2147483649LL, 2147483648LL, 0, ok);
+        if (!ok || !in.atEnd())
+            return false;
+
+        clear();
+        root = staged.root;
+        count = keys;
+        staged.root = 0;
+        pool.swap(staged.pool);
+        return true;
+    }
+
+    // Moves every key of other into this tree, leaving other empty. The
+    // smaller tree is copied into the larger one's pool, then split/join
+    // union runs in O(m log(n/m + 1)) for sizes m <= n.
+    void mergeFrom(AVLTree& other) {
+        if (&other == this || other.root == 0) return;
+        beginOperation();
+        if (other.count > count) {
+            Node* larger = other.root;
+            other.root = root;
+            root = larger;
+            int largerCount = other.count;
+            other.count = count;
+            count = largerCount;
+            pool.swap(other.pool);
+        }
+        Node* copy = cloneSubtree(other.root);
+        other.clear();
+        root = unite(root, copy);
+        count = sizeOf(root);
+    }
+
+    bool contains(int key) {
+        return find(key) != 0;
+    }
+
+    int getSize() {
+        return count;
+    }
+
+    // Every key in ascending order
+    IntBuffer& inorder() {
+        output.clear();
+        output.reserve(count);
+        if (count > 0) collectRange(-2147483647 - 1, 2147483647);
+        return output;
+    }
+
+    // Number of keys smaller than key
+    int rank(int key) {
+        return countBelow(key, false);
+    }
+
+    // Key with rank i (0 = smallest), -999999 when out of range
+    int select(int i) {
+        if (i < 0 || i >= count) return -999999;
+        Node* cur = root;
+        while (true) {
+            counters.add(COUNT_COMPARE);
+            int leftSize = sizeOf(cur->left);
+            if (i < leftSize) {
+                cur = cur->left;
+            }
+            else if (i == leftSize) {
+                return cur->key;
+            }
+            else {
+                i -= leftSize + 1;
+                cur = cur->right;
+            }
+        }
+    }
+
+    // Keys k with lo <= k <= hi
+    int rangeCount(int lo, int hi) {
+        if (lo > hi) return 0;
+        return countBelow(hi, true) - countBelow(lo, false);
+    }
+
+    // Those keys in ascending order
+    IntBuffer& rangeCollect(int lo, int hi) {
+        output.clear();
+        if (lo <= hi) collectRange(lo, hi);
+        return output;
+    }
+
+    // Whole tree in the exportSubtree layout; record 0 is the root
+    IntBuffer& exportTree() {
+        exportSubtree(root);
+        return output;
+    }
+
+    // Subtree rooted at key (empty if absent), e.g. the last changed key
+    IntBuffer& exportSubtreeAt(int key) {
+        exportSubtree(find(key));
+        return output;
+    }
+
+    IntBuffer& getChanged() {
+        return changed;
+    }
+
+    // "[[key,height,left,right],...]"
+    string getTree() {
+        exportTree();
+        string result = "[";
+        for (int i = 0; i < output.size; i += 4) {
+            if (i > 0) result += ",";
+            result += formatList(output.data + i, 4);
+        }
+        result += "]";
+        return result;
+    }
+
+    // "LL", "LR", "RR" or "RL" for the last rotation of the last
+    // operation, "" when it needed none
+    string getLastRotation() {
+        return lastRotation;
+    }
+
+    void clear() {
+        beginOperation();
+        root = 0;
+        count = 0;
+        pool.reset();
+    }
+
+    // Bytes owned by the tree: the object, every pool chunk (live and
+    // recycled nodes) and the export, trace and counter buffers
+    size_t memoryUsage() const {
+        return sizeof(*this) + pool.heapBytes() + changed.heapBytes() +
+            output.heapBytes() + trace.heapBytes() + counters.heapBytes() +
+            snapshot.heapBytes();
+    }
+
+    // Copies the live nodes into a pool sized for them and frees the old
+    // chunks, so slack left by large deletions goes back; O(n)
+    void shrinkToFit() {
+        NodePool<Node> old;
+        old.swap(pool);
+        root = cloneSubtree(root);
+        output.release();
+        trace.shrink();
+        counters.shrink();
+        snapshot.release();
+    }
+
+    // Step tracing (see TRACE BUFFER); capacity in events, 0 turns it off
+    void enableTrace(int capacity) {
+        trace.enable(capacity);
+    }
+
+    void disableTrace() {
+        trace.disable();
+    }
+
+    void clearTrace() {
+        trace.clear();
+    }
+
+    int getTraceDropped() {
+        return trace.getDropped();
+    }
+
+    IntBuffer& exportTrace() {
+        return trace.exportEvents();
+    }
+
+    // Work totals (see OP COUNTERS)
+    void resetCounters() {
+        counters.reset();
+    }
+
+    IntBuffer& exportCounters() {
+        return counters.exportValues();
+    }
+};
+
+// Timeline of an AVL tree for scrubbing through its operations. Nodes are
+// never changed once a version is sealed: insert and remove copy only the
+// O(log n) nodes on the search path (and those a rotation rebuilds) and
+// share every other subtree, so each version costs a few hundred bytes
+// and checkout() or getTreeAt() reach any of them in O(1). Changing an
+// older checked-out version discards the versions after it and recycles
+// their nodes, like an undo history.
+class PersistentAVLTree {
+private:
+    struct Node {
+        int key;
+        int height;
+        int size;
+        int left;  // node index, -1 for none
+        int right;
+    };
+
+    struct Version {
+        int root;     // -1 when empty
+        int nodes;    // arena size once sealed; later nodes are newer versions'
+        int rotation; // last rotation of the operation, ROTATION_NONE if none
+    };
+
+    enum { ROTATION_NONE = 0, ROTATION_LL = 1, ROTATION_LR = 2, ROTATION_RR = 3, ROTATION_RL = 4 };
+
+    // Deep enough for any AVL height over int node counts (see AVLTree)
+    static const int MAX_PATH = 64;
+
+    ChunkedArena<Node> nodes;
+    ChunkedArena<Version> versions;
+    int current;  // checked-out version
+    int rotation; // of the running operation
+    IntBuffer output;
+
+    PersistentAVLTree(const PersistentAVLTree&);
+    PersistentAVLTree& operator=(const PersistentAVLTree&);
+
+    int height(int n) const {
+        return (n == -1) ? 0 : nodes.at(n).height;
+    }
+
+    int sizeOf(int n) const {
+        return (n == -1) ? 0 : nodes.at(n).size;
+    }
+
+    int make(int key, int left, int right) {
+        Node node;
+        node.key = key;
+        node.left = left;
+        node.right = right;
+        node.height = 1 + ((height(left) > height(right)) ? height(left) : height(right));
+        node.size = 1 + sizeOf(left) + sizeOf(right);
+        return nodes.push(node);
+    }
+
+    // New node for key over left and right, whose heights differ by at
+    // most two; rotations build new nodes instead of relinking old ones
+    int balance(int key, int left, int right) {
+        int hl = height(left);
+        int hr = height(right);
+        if (hl > hr + 1) {
+            const Node& l = nodes.at(left);
+            if (height(l.left) >= height(l.right)) {
+                rotation = ROTATION_LL;
+                return make(l.key, l.left, make(key, l.right, right));
+            }
+            const Node& lr = nodes.at(l.right);
+            rotation = ROTATION_LR;
+            return make(lr.key, make(l.key, l.left, lr.left), make(key, lr.right, right));
+        }
+        if (hr > hl + 1) {
+            const Node& r = nodes.at(right);
+            if (height(r.right) >= height(r.left)) {
+                rotation = ROTATION_RR;
+                return make(r.key, make(key, left, r.left), r.right);
+            }
+            const Node& rl = nodes.at(r.left);
+            rotation = ROTATION_RL;
+            return make(rl.key, make(key, left, rl.left), make(r.key, rl.right, r.right));
+        }
+        return make(key, left, right);
+    }
+
+    // Path copy of t with key added; the key must be absent
+    int insertAt(int t, int key) {
+        if (t == -1) return make(key, -1, -1);
+        const Node& node = nodes.at(t); // arena pushes never move nodes
+        if (key < node.key) return balance(node.key, insertAt(node.left, key), node.right);
+        return balance(node.key, node.left, insertAt(node.right, key));
+    }
+
+    // Path copy of t without its smallest key, which goes into minKey
+    int removeMin(int t, int& minKey) {
+        const Node& node = nodes.at(t);
+        if (node.left == -1) {
+            minKey = node.key;
+            return node.right;
+        }
+        return balance(node.key, removeMin(node.left, minKey), node.right);
+    }
+
+    // Path copy of t without key; the key must be present
+    int removeAt(int t, int key) {
+        const Node& node = nodes.at(t);
+        if (key < node.key) return balance(node.key, removeAt(node.left, key), node.right);
+        if (key > node.key) return balance(node.key, node.left, removeAt(node.right, key));
+        if (node.left == -1) return node.right;
+        if (node.right == -1) return node.left;
+        int successor;
+        int right = removeMin(node.right, successor);
+        return balance(successor, node.left, right);
+    }
+
+    // Builds on the checked-out version; newer ones and their nodes go
+    int begin() {
+        versions.truncate(current + 1);
+        nodes.truncate(versions.at(current).nodes);
+        rotation = ROTATION_NONE;
+        return versions.at(current).root;
+    }
+
+    void commit(int root) {
+        Version v = { root, nodes.size(), rotation };
+        current = versions.push(v);
+    }
+
+    // Node copies of another arena's subtree, children first
+    int copyFrom(const ChunkedArena<Node>& from, int t) {
+        if (t == -1) return -1;
+        const Node& node = from.at(t);
+        int left = copyFrom(from, node.left);
+        int right = copyFrom(from, node.right);
+        return make(node.key, left, right);
+    }
+
+    static string rotationName(int code) {
+        switch (code) {
+            case ROTATION_LL: return "LL";
+            case ROTATION_LR: return "LR";
+            case ROTATION_RR: return "RR";
+            case ROTATION_RL: return "RL";
+            default: return "";
+        }
+    }
+
+    bool validVersion(int version) const {
+        return version >= 0 && version < versions.size();
+    }
+
+public:
+    PersistentAVLTree() : current(0), rotation(ROTATION_NONE) {
+        Version empty = { -1, 0, ROTATION_NONE };
+        versions.push(empty);
+    }
+
+    // Inserting a present key or removing a missing one changes nothing
+    // and seals no version
+    void insert(int key) {
+        if (contains(key)) return;
+        int root = begin();
+        commit(insertAt(root, key));
+    }
+
+    void remove(int key) {
+        if (!contains(key)) return;
+        int root = begin();
+        commit(removeAt(root, key));
+    }
+
+    void clear() {
+        if (versions.at(current).root == -1) return;
+        begin();
+        commit(-1);
+    }
+
+    bool contains(int key) {
+        int cur = versions.at(current).root;
+        while (cur != -1 && nodes.at(cur).key != key) {
+            cur = (key < nodes.at(cur).key) ? nodes.at(cur).left : nodes.at(cur).right;
+        }
+        return cur != -1;
+    }
+
+    // Version 0 is the empty tree this one started as
+    int getVersion() {
+        return current;
+    }
+
+    int getVersionCount() {
+        return versions.size();
+    }
+
+    // Makes version the current one in O(1); false if there is none
+    bool checkout(int version) {
+        if (!validVersion(version)) return false;
+        current = version;
+        return true;
+    }
+
+    int getSize() {
+        return sizeOf(versions.at(current).root);
+    }
+
+    int getSizeAt(int version) {
+        return validVersion(version) ? sizeOf(versions.at(version).root) : 0;
+    }
+
+    // "LL", "LR", "RR" or "RL" for the last rotation of the operation that
+    // made the current version, "" when it needed none
+    string getLastRotation() {
+        return rotationName(versions.at(current).rotation);
+    }
+
+    string getRotationAt(int version) {
+        return validVersion(version) ? rotationName(versions.at(version).rotation) : "";
+    }
+
+    // Version's tree in the AVLTree::exportTree() layout: preorder records
+    // of (key, height, left index, right index), record 0 the root
+    IntBuffer& exportTreeAt(int version) {
+        output.clear();
+        if (!validVersion(version) || versions.at(version).root == -1) return output;
+        output.reserve(sizeOf(versions.at(version).root) * 4);
+
+        int stack[MAX_PATH * 2][3]; // node, parent record, slot in it
+        int sp = 0;
+        stack[sp][0] = versions.at(version).root;
+        stack[sp][1] = -1;
+        stack[sp][2] = 0;
+        sp++;
+        while (sp > 0) {
+            sp--;
+            const Node& node = nodes.at(stack[sp][0]);
+            int record = output.size / 4;
+            if (stack[sp][1] != -1) output.data[stack[sp][1] * 4 + stack[sp][2]] = record;
+            output.push(node.key);
+            output.push(node.height);
+            output.push(-1);
+            output.push(-1);
+
+            // Right first so the left subtree is emitted next
+            if (node.right != -1) {
+                stack[sp][0] = node.right;
+                stack[sp][1] = record;
+                stack[sp][2] = 3;
+                sp++;
+            }
+            if (node.left != -1) {
+                stack[sp][0] = node.left;
+                stack[sp][1] = record;
+                stack[sp][2] = 2;
+                sp++;
+            }
+        }
+        return output;
+    }
+
+    // "[[key,height,left,right],...]", as AVLTree::getTree()
+    string getTreeAt(int version) {
+        exportTreeAt(version);
+        string result = "[";
+        for (int i = 0; i < output.size; i += 4) {
+            if (i > 0) result += ",";
+            result += formatList(output.data + i, 4);
+        }
+        result += "]";
+        return result;
+    }
+
+    string getTree() {
+        return getTreeAt(current);
+    }
+
+    // Keeps only the current version, renumbered 0, in fresh nodes
+    void discardHistory() {
+        Version kept = versions.at(current);
+        ChunkedArena<Node> old;
+        old.swap(nodes);
+        int root = copyFrom(old, kept.root);
+        versions.truncate(0);
+        versions.trim();
+        rotation = kept.rotation;
+        commit(root);
+    }
+
+    // Bytes owned by the timeline: the object, every node of every
+    // version, the version table and the export buffer
+    size_t memoryUsage() const {
+        return sizeof(*this) + nodes.heapBytes() + versions.heapBytes() + output.heapBytes();
+    }
+
+    // Frees arena chunks left spare by discarded versions
+    void shrinkToFit() {
+        nodes.trim();
+        versions.trim();
+        output.release();
+    }
+};
+
+// ===================== CSR EDGE STORE =====================
+// Compressed sparse row storage: row u owns targets/weights in
+// [offsets[u], offsets[u + 1]), sorted by target. Writes go to an append-only
+// log (last write wins, weight 0 removes) that is merged on the next build(),
+// so a batch of addEdge calls costs one O(n + m) rebuild instead of shifting
+// the arrays on every call.
+class CSR {
+private:
+    int n;
+    int* offsets;
+    int offsetsCap;
+    int* targets;
+    int* weights;
+    int edgeCount;
+    int edgeCap; // length of targets / weights
+
+    int* logU;
+    int* logV;
+    int* logW;
+    int logSize;
+    int logCap;
+
+    void growLog() {
+        int newCap = (logCap == 0) ? 16 : logCap * 2;
+        int* nu = new int[newCap];
+        int* nv = new int[newCap];
+        int* nw = new int[newCap];
+        for (int i = 0; i < logSize; i++) {
+            nu[i] = logU[i];
+            nv[i] = logV[i];
+            nw[i] = logW[i];
+        }
+        delete[] logU;
+        delete[] logV;
+        delete[] logW;
+        logU = nu;
+        logV = nv;
+        logW = nw;
+        logCap = newCap;
+    }
+
+    // Stable counting sort of (keys, a, b) by keys into (outKeys, outA, outB)
+    void countingSort(int total, const int* keys, const int* a, const int* b,
+        int* outKeys, int* outA, int* outB, int* count) {
+        for (int i = 0; i <= n; i++) count[i] = 0;
+        for (int i = 0; i < total; i++) count[keys[i] + 1]++;
+        for (int i = 0; i < n; i++) count[i + 1] += count[i];
+        for (int i = 0; i < total; i++) {
+            int pos = count[keys[i]]++;
+            outKeys[pos] = keys[i];
+            outA[pos] = a[i];
+            outB[pos] = b[i];
+        }
+    }
+
+public:
+    CSR(int vertices) : n(vertices), offsetsCap(vertices + 1), targets(NULL), weights(NULL),
+        edgeCount(0), edgeCap(0), logU(NULL), logV(NULL), logW(NULL), logSize(0), logCap(0) {
+        offsets = new int[offsetsCap];
+        for (int i = 0; i <= n; i++) offsets[i] = 0;
+    }
+
+    ~CSR() {
+        delete[] offsets;
+        delete[] targets;
+        delete[] weights;
+        delete[] logU;
+        delete[] logV;
+        delete[] logW;
+    }
+
+    void set(int u, int v, int w) {
+        if (logSize == logCap) growLog();
+        logU[logSize] = u;
+        logV[logSize] = v;
+        logW[logSize] = w;
+        logSize++;
+    }
+
+    bool isDirty() {
+        return logSize > 0;
+    }
+
+    // Merges the write log into the CSR arrays in O(n + m + log): the current
+    // edges followed by the log are radix sorted by (u, v), then each (u, v)
+    // run keeps only its last record.
+    void build() {
+        if (logSize == 0) return;
+
+        int total = edgeCount + logSize;
+        int* su = new int[total];
+        int* sv = new int[total];
+        int* sw = new int[total];
+        int k = 0;
+        for (int u = 0; u < n; u++) {
+            for (int e = offsets[u]; e < offsets[u + 1]; e++) {
+                su[k] = u;
+                sv[k] = targets[e];
+                sw[k] = weights[e];
+                k++;
+            }
+        }
+        for (int i = 0; i < logSize; i++) {
+            su[k] = logU[i];
+            sv[k] = logV[i];
+            sw[k] = logW[i];
+            k++;
+        }
+
+        int* tu = new int[total];
+        int* tv = new int[total];
+        int* tw = new int[total];
+        int* count = new int[n + 1];
+        countingSort(total, sv, su, sw, tv, tu, tw, count);
+        countingSort(total, tu, tv, tw, su, sv, sw, count);
+        delete[] tu;
+        delete[] tv;
+        delete[] tw;
+        delete[] count;
+
+        int kept = 0;
+        for (int i = 0; i < total; i++) {
+            bool lastOfRun = (i == total - 1) || su[i + 1] != su[i] || sv[i + 1] != sv[i];
+            if (lastOfRun && sw[i] != 0) kept++;
+        }
+
+        delete[] targets;
+        delete[] weights;
+        edgeCap = kept > 0 ? kept : 1;
+        targets = new int[edgeCap];
+        weights = new int[edgeCap];
+        for (int i = 0; i <= n; i++) offsets[i] = 0;
+
+        int pos = 0;
+        for (int i = 0; i < total; i++) {
+            bool lastOfRun = (i == total - 1) || su[i + 1] != su[i] || sv[i + 1] != sv[i];
+            if (lastOfRun && sw[i] != 0) {
+                targets[pos] = sv[i];
+                weights[pos] = sw[i];
+                offsets[su[i] + 1]++;
+                pos++;
+            }
+        }
+        for (int i = 0; i < n; i++) offsets[i + 1] += offsets[i];
+        edgeCount = kept;
+
+        delete[] su;
+        delete[] sv;
+        delete[] sw;
+        logSize = 0;
+    }
+
+    // Weight of edge u -> v in the last built snapshot, 0 if absent
+    int get(int u, int v) {
+        int lo = offsets[u];
+        int hi = offsets[u + 1] - 1;
+        while (lo <= hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (targets[mid] == v) return weights[mid];
+            if (targets[mid] < v) lo = mid + 1;
+            else hi = mid - 1;
+        }
+        return 0;
+    }
+
+    // Appends an empty row u = n; offsets grow geometrically
+    void addVertex() {
+        if (n + 2 > offsetsCap) {
+            int newCap = offsetsCap + offsetsCap / 2 + 8;
+            int* grown = new int[newCap];
+            for (int i = 0; i <= n; i++) grown[i] = offsets[i];
+            delete[] offsets;
+            offsets = grown;
+            offsetsCap = newCap;
+        }
+        offsets[n + 1] = offsets[n];
+        n++;
+    }
+
+    int rowBegin(int u) { return offsets[u]; }
+    int rowEnd(int u) { return offsets[u + 1]; }
+    int target(int e) { return targets[e]; }
+    int weight(int e) { return weights[e]; }
+    int edges() { return edgeCount; }
+
+    void clear() {
+        for (int i = 0; i <= n; i++) offsets[i] = 0;
+        edgeCount = 0;
+        logSize = 0;
+    }
+
+    size_t heapBytes() const {
+        return ((size_t)offsetsCap + 2 * (size_t)edgeCap + 3 * (size_t)logCap) * sizeof(int);
+    }
+
+    // Merges any pending writes, then trims the arrays to n + 1 offsets and
+    // edgeCount edges and frees the write log
+    void shrinkToFit() {
+        build();
+        if (offsetsCap > n + 1) {
+            int* fitted = new int[n + 1];
+            for (int i = 0; i <= n; i++) fitted[i] = offsets[i];
+            delete[] offsets;
+            offsets = fitted;
+            offsetsCap = n + 1;
+        }
+        if (edgeCap > edgeCount) {
+            int* fittedTargets = NULL;
+            int* fittedWeights = NULL;
+            if (edgeCount > 0) {
+                fittedTargets = new int[edgeCount];
+                fittedWeights = new int[edgeCount];
+                for (int e = 0; e < edgeCount; e++) {
+                    fittedTargets[e] = targets[e];
+                    fittedWeights[e] = weights[e];
+                }
+            }
+            delete[] targets;
+            delete[] weights;
+            targets = fittedTargets;
+            weights = fittedWeights;
+            edgeCap = edgeCount;
+        }
+        delete[] logU;
+        delete[] logV;
+        delete[] logW;
+        logU = logV = logW = NULL;
+        logCap = 0;
+    }
+};
+
+// ===================== TASK POOL =====================
+// Atomic read-modify-write on plain arrays shared by pool workers. In
+// single-threaded builds these compile to ordinary loads and stores.
+inline uint64_t atomicLoad(const uint64_t* word) {
+    return __atomic_load_n(word, __ATOMIC_RELAXED);
+}
+
+inline int atomicLoad(const int* slot) {
+    return __atomic_load_n(slot, __ATOMIC_RELAXED);
+}
+
+// Returns the bits of *word before the OR
+inline uint64_t atomicOr(uint64_t* word, uint64_t bits) {
+    return __atomic_fetch_or(word, bits, __ATOMIC_RELAXED);
+}
+
+// Lowers *slot to value; true if this call lowered it
+inline bool atomicMin(int* slot, int value) {
+    int current = __atomic_load_n(slot, __ATOMIC_RELAXED);
+    while (value < current) {
+        if (__atomic_compare_exchange_n(slot, &current, value, true,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            return true;
+    }
+    return false;
+}
+
+inline bool atomicMin(uint64_t* slot, uint64_t value) {
+    uint64_t current = __atomic_load_n(slot, __ATOMIC_RELAXED);
+    while (value < current) {
+        if (__atomic_compare_exchange_n(slot, &current, value, true,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            return true;
+    }
+    return false;
+}
+
+// Fork-join parallelFor over an index range, shared by the graph
+// algorithms. The range is cut into grain-sized chunks and dealt out
+// evenly to one lane per participant (the calling thread is lane 0).
+// Each participant works through its own lane front to back, and steals
+// from the back of other lanes once its own is empty. Builds without
+// pthreads (no -pthread / DSV_THREADS) run the body inline on the
+// caller, so every algorithm keeps a single code path.
+class TaskPool {
+private:
+    typedef void (*ChunkFn)(void* ctx, int begin, int end, int worker);
+
+    template <typename Body>
+    static void invoke(void* ctx, int begin, int end, int worker) {
+        (*static_cast<Body*>(ctx))(begin, end, worker);
+    }
+
+#if DSV_HAS_THREADS
+    static const int MAX_THREADS = 64;
+
+    struct Lane {
+        std::mutex lock;
+        int lo; // next chunk for the owner
+        int hi; // one past the next chunk for thieves
+    };
+
+    Lane lanes[MAX_THREADS];
+    std::thread* workers[MAX_THREADS];
+    int threadCount;
+
+    std::mutex jobLock; // one parallelFor at a time
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned long generation;
+    bool stopping;
+    std::atomic<int> remaining;
+
+    ChunkFn fn;
+    void* ctx;
+    int jobBegin;
+    int jobEnd;
+    int jobGrain;
+
+    static bool& inWorker() {
+        static thread_local bool flag = false;
+        return flag;
+    }
+
+    int takeChunk(int lane) {
+        {
+            std::lock_guard<std::mutex> guard(lanes[lane].lock);
+            if (lanes[lane].lo < lanes[lane].hi) return lanes[lane].lo++;
+        }
+        for (int k = 1; k < threadCount; k++) {
+            Lane& victim = lanes[(lane + k) % threadCount];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (victim.lo < victim.hi) return --victim.hi;
+        }
+        return -1;
+    }
+
+    void runChunks(int lane) {
+        int chunk;
+        while ((chunk = takeChunk(lane)) != -1) {
+            int begin = jobBegin + chunk * jobGrain;
+            int end = (jobEnd - begin > jobGrain) ? begin + jobGrain : jobEnd;
+            fn(ctx, begin, end, lane);
+            if (remaining.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> guard(wakeLock);
+                done.notify_all();
+            }
+        }
+    }
+
+    void workerLoop(int lane) {
+        inWorker() = true;
+        unsigned long seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard(wakeLock);
+                while (!stopping && generation == seen) wake.wait(guard);
+                if (stopping) return;
+                seen = generation;
+            }
+            runChunks(lane);
+        }
+    }
+
+    void stopWorkers() {
+        {
+            std::lock_guard<std::mutex> guard(wakeLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (int i = 1; i < threadCount; i++) {
+            workers[i]->join();
+            delete workers[i];
+        }
+        stopping = false;
+        threadCount = 1;
+    }
+
+    void run(int begin, int end, int grain, ChunkFn chunkFn, void* chunkCtx) {
+        std::lock_guard<std::mutex> job(jobLock);
+        int chunks = (end - begin + grain - 1) / grain;
+
+        fn = chunkFn;
+        ctx = chunkCtx;
+        jobBegin = begin;
+        jobEnd = end;
+        jobGrain = grain;
+        remaining.store(chunks);
+        for (int i = 0; i < threadCount; i++) {
+            std::lock_guard<std::mutex> guard(lanes[i].lock);
+            lanes[i].lo = (int)((long long)chunks * i / threadCount);
+            lanes[i].hi = (int)((long long)chunks * (i + 1) / threadCount);
+        }
+        {
+            std::lock_guard<std::mutex> guard(wakeLock);
+            generation++;
+        }
+        wake.notify_all();
+
+        runChunks(0);
+        std::unique_lock<std::mutex> guard(wakeLock);
+        while (remaining.load() != 0) done.wait(guard);
+    }
+
+    TaskPool() : threadCount(1), generation(0), stopping(false), remaining(0),
+        fn(NULL), ctx(NULL), jobBegin(0), jobEnd(0), jobGrain(1) {
+        int hardware = (int)std::thread::hardware_concurrency();
+        setThreadCount(hardware > 0 ? hardware : 1);
+    }
+
+    ~TaskPool() {
+        stopWorkers();
+    }
+#else
+    TaskPool() {}
+#endif
+
+    TaskPool(const TaskPool&);
+    TaskPool& operator=(const TaskPool&);
+
+public:
+    static TaskPool& shared() {
+        static TaskPool instance;
+        return instance;
+    }
+
+    // Participants including the caller; always 1 without pthreads
+    int getThreadCount() {
+#if DSV_HAS_THREADS
+        return threadCount;
+#else
+        return 1;
+#endif
+    }
+
+    // Restarts the workers. Under emscripten every worker comes from the
+    // PTHREAD_POOL_SIZE pool, so size that to the largest count used.
+    void setThreadCount(int count) {
+#if DSV_HAS_THREADS
+        std::lock_guard<std::mutex> job(jobLock);
+        if (count < 1) count = 1;
+        if (count > MAX_THREADS) count = MAX_THREADS;
+        stopWorkers();
+        threadCount = count;
+        for (int i = 1; i < threadCount; i++) {
+            workers[i] = new std::thread(&TaskPool::workerLoop, this, i);
+        }
+#else
+        (void)count;
+#endif
+    }
+
+    // Calls body(chunkBegin, chunkEnd, worker) over [begin, end) in chunks
+    // of at most grain indices, worker in [0, getThreadCount()). Returns
+    // once every chunk has run. Nested calls from a worker run inline.
+    template <typename Body>
+    void parallelFor(int begin, int end, int grain, Body body) {
+        if (end <= begin) return;
+        if (grain < 1) grain = 1;
+#if DSV_HAS_THREADS
+        if (threadCount > 1 && !inWorker() && end - begin > grain) {
+            run(begin, end, grain, &invoke<Body>, &body);
+            return;
+        }
+#endif
+        body(begin, end, 0);
+    }
+};
+
+// ===================== UNION FIND (FOR KRUSKAL/BORUVKA) =====================
+// Disjoint sets with path compression and union by rank: near-constant
+// amortized find, no recursion.
+class UnionFind {
+private:
+    int* parent;
+    int* rank;
+    int n;
+
+public:
+    UnionFind(int size) : n(size) {
+        parent = new int[n > 0 ? n : 1];
+        rank = new int[n > 0 ? n : 1];
+        for (int i = 0; i < n; i++) {
+            parent[i] = i;
+            rank[i] = 0;
+        }
+    }
+
+    ~UnionFind() {
+        delete[] parent;
+        delete[] rank;
+    }
+
+    int find(int x) {
+        int root = x;
+        while (parent[root] != root) root = parent[root];
+        while (parent[x] != root) {
+            int next = parent[x];
+            parent[x] = root;
+            x = next;
+        }
+        return root;
+    }
+
+    // False if a and b were already in the same set
+    bool unite(int a, int b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return false;
+        if (rank[a] < rank[b]) {
+            int t = a;
+            a = b;
+            b = t;
+        }
+        parent[b] = a;
+        if (rank[a] == rank[b]) rank[a]++;
+        return true;
+    }
+};
+
+// ===================== QUERY CACHE =====================
+// Recent query results, least recently used first out. An entry is keyed
+// on (kind, a, b) plus the owner's version number, which every write
+// bumps, so a write needs no flush: stale entries stop matching and are
+// freed by the next store(). Bounded by entry count and by the ints held
+// across all entries.
+enum QueryKind {
+    QUERY_BFS = 1,
+    QUERY_DFS = 2,
+    QUERY_DIJKSTRA = 3,
+    QUERY_DELTA_STEPPING = 4,
+    QUERY_PRIM = 5,
+    QUERY_KRUSKAL = 6,
+    QUERY_BORUVKA = 7
+};
+
+class QueryCache {
+private:
+    static const int MAX_ENTRIES = 32;
+
+    struct Entry {
+        int kind; // 0 = unused
+        int a;
+        int b;
+        unsigned int version;
+        unsigned int lastUse;
+        IntBuffer result;
+    };
+
+    Entry entries[MAX_ENTRIES];
+    int capacity;     // entries in use at most, 0 turns the cache off
+    int maxInts;      // result ints across all entries
+    long long held;
+    unsigned int clock;
+    int hits;
+    int misses;
+
+    QueryCache(const QueryCache&);
+    QueryCache& operator=(const QueryCache&);
+
+    void drop(Entry& entry) {
+        held -= entry.result.size;
+        entry.result.release();
+        entry.kind = 0;
+    }
+
+    // An unused slot, else the least recently used entry
+    Entry& victim() {
+        Entry* best = &entries[0];
+        for (int i = 0; i < capacity; i++) {
+            Entry& entry = entries[i];
+            if (entry.kind == 0) return entry;
+            if (entry.lastUse < best->lastUse) best = &entry;
+        }
+        return *best;
+    }
+
+public:
+    QueryCache(int entryCount = 8, int intLimit = 1 << 22)
+        : capacity(0), maxInts(intLimit > 0 ? intLimit : 0), held(0), clock(0), hits(0), misses(0) {
+        for (int i = 0; i < MAX_ENTRIES; i++) entries[i].kind = 0;
+        setCapacity(entryCount);
+    }
+
+    // Result of an earlier store() with the same key and version, or NULL
+    IntBuffer* find(int kind, int a, int b, unsigned int version) {
+        for (int i = 0; i < capacity; i++) {
+            Entry& entry = entries[i];
+            if (entry.kind == kind && entry.a == a && entry.b == b && entry.version == version) {
+                entry.lastUse = ++clock;
+                hits++;
+                return &entry.result;
+            }
+        }
+        if (capacity > 0) misses++;
+        return NULL;
+    }
+
+    // Copies result in, first dropping entries of older versions, then
+    // least recently used ones until it fits; results larger than the
+    // whole budget are not kept
+    void store(int kind, int a, int b, unsigned int version, const IntBuffer& result) {
+        if (capacity == 0 || result.size > maxInts) return;
+        for (int i = 0; i < capacity; i++) {
+            if (entries[i].kind != 0 && entries[i].version != version) drop(entries[i]);
+        }
+        while (held + result.size > maxInts) {
+            Entry& oldest = victim();
+            if (oldest.kind == 0) break;
+            drop(oldest);
+        }
+        Entry& entry = victim();
+        if (entry.kind != 0) drop(entry);
+        entry.kind = kind;
+        entry.a = a;
+        entry.b = b;
+        entry.version = version;
+        entry.lastUse = ++clock;
+        entry.result.clear();
+        entry.result.reserve(result.size);
+        for (int i = 0; i < result.size; i++) entry.result.data[i] = result.data[i];
+        entry.result.size = result.size;
+        held += result.size;
+    }
+
+    void clear() {
+        for (int i = 0; i < MAX_ENTRIES; i++) {
+            if (entries[i].kind != 0) drop(entries[i]);
+        }
+    }
+
+    // Bytes of result storage across all entries
+    size_t heapBytes() const {
+        size_t bytes = 0;
+        for (int i = 0; i < MAX_ENTRIES; i++) bytes += entries[i].result.heapBytes();
+        return bytes;
+    }
+
+    // Entries kept at most (up to 32); 0 turns the cache off
+    void setCapacity(int entryCount) {
+        if (entryCount < 0) entryCount = 0;
+        if (entryCount > MAX_ENTRIES) entryCount = MAX_ENTRIES;
+        for (int i = entryCount; i < MAX_ENTRIES; i++) {
+            if (entries[i].kind != 0) drop(entries[i]);
+        }
+        capacity = entryCount;
+    }
+
+    int getCapacity() {
+        return capacity;
+    }
+
+    int getHits() {
+        return hits;
+    }
+
+    int getMisses() {
+        return misses;
+    }
+
+    int getEntryCount() {
+        int count = 0;
+        for (int i = 0; i < capacity; i++) {
+            if (entries[i].kind != 0) count++;
+        }
+        return count;
+    }
+};
+
+// ===================== 3. GRAPH (ADJACENCY MATRIX / CSR) =====================
+enum GraphStorage {
+    STORAGE_AUTO = 0,
+    STORAGE_MATRIX = 1,
+    STORAGE_CSR = 2,
+    STORAGE_BITSET = 3 // unweighted: one bit per cell, every edge weighs 1
+};
+
+// A* estimate of the remaining distance, from setCoordinates() positions
+// scaled by the given factor. It must not overestimate (scale at most
+// the smallest weight per unit of distance) for paths to stay shortest.
+enum PathHeuristic {
+    HEURISTIC_NONE = 0,
+    HEURISTIC_EUCLIDEAN = 1,
+    HEURISTIC_MANHATTAN = 2
+};
+
+class Graph {
+    // Resumable traversals walk the storage directly
+    friend class BfsIterator;
+    friend class DfsIterator;
+    friend class DijkstraIterator;
+    friend class GraphLoader;
+    friend class ForceLayout;
+
+private:
+    // Largest graph STORAGE_AUTO keeps as a matrix (n*n ints = 16 MB)
+    static const int MATRIX_AUTO_LIMIT = 2048;
+    // Largest vertex count deserialize() accepts (2^24 ids). Matrix
+    // snapshots above MATRIX_AUTO_LIMIT and bitset ones above
+    // BITSET_SNAPSHOT_LIMIT (n^2 / 8 bytes = 128 MB) are restored as CSR.
+    static const int SNAPSHOT_MAX_VERTICES = 1 << 24;
+    static const int BITSET_SNAPSHOT_LIMIT = 1 << 15;
+    // STORAGE_AUTO switches an existing graph to CSR below 1/8 density
+    static const int CSR_DENSITY_DIVISOR = 8;
+
+    int n;         // vertex ids in use, tombstones included
+    int vertexCap; // ids the matrix / bitset storage has room for
+    bool* alive;   // false for removed (tombstoned) ids
+    int deadCount;
+    int compactions;
+    IntBuffer idMap; // old id -> new id (-1 removed) of the last compaction
+    int** adjMatrix;
+    CSR* csr;
+    uint64_t* bits; // row-major, rowWords 64-bit words per row
+    int rowWords;
+    int storage;
+    bool isDirected;
+    IntBuffer output;
+    CSR* reverse;      // incoming edges of directed graphs, built on demand
+    bool reverseValid; // cleared by every write (markWritten)
+    unsigned int version; // bumped by every write, keys the query cache
+    QueryCache cache;     // bfs, dfs, dijkstra, delta-stepping and MST results
+    IntBuffer levels;  // (size, direction, edges checked) per BFS level
+    TraceBuffer trace; // bfs, dfs, dijkstra, prim, kruskal and point-to-point
+    OpCounters counters; // dijkstra and prim
+    IntBuffer snapshot;
+    SearchFrontier* forward;  // point-to-point scratch, kept across queries
+    SearchFrontier* backward;
+    float* coords;            // (x, y) per vertex for A*, NULL until set
+    int coordCount;           // vertices below this id have coordinates
+    float heuristicScale;
+    int heuristic;
+    int pathDistance;         // length of the last point-to-point path
+
+    void allocMatrix() {
+        adjMatrix = new int* [vertexCap];
+        for (int i = 0; i < vertexCap; i++) {
+            adjMatrix[i] = new int[vertexCap];
+            for (int j = 0; j < vertexCap; j++) {
+                adjMatrix[i][j] = 0;
+            }
+        }
+    }
+
+    void freeMatrix() {
+        if (adjMatrix == NULL) return;
+        for (int i = 0; i < vertexCap; i++) {
+            delete[] adjMatrix[i];
+        }
+        delete[] adjMatrix;
+        adjMatrix = NULL;
+    }
+
+    void allocBits() {
+        rowWords = (vertexCap + 63) / 64;
+        size_t words = (size_t)vertexCap * rowWords;
+        bits = new uint64_t[words > 0 ? words : 1];
+        for (size_t i = 0; i < words; i++) bits[i] = 0;
+    }
+
+    uint64_t* bitRow(int u) {
+        return bits + (size_t)u * rowWords;
+    }
+
+    bool hasBit(int u, int v) {
+        return (bitRow(u)[v >> 6] >> (v & 63)) & 1;
+    }
+
+    void allocStorage() {
+        if (storage == STORAGE_MATRIX) allocMatrix();
+        else if (storage == STORAGE_BITSET) allocBits();
+        else csr = new CSR(n);
+    }
+
+    void freeStorage() {
+        freeMatrix();
+        delete csr;
+        csr = NULL;
+        delete[] bits;
+        bits = NULL;
+    }
+
+    // Makes room for newCap vertex ids (n at least). Matrix and bitset rows
+    // are copied into the new square; CSR rows grow one at a time on their
+    // own.
+    void resizeCapacity(int newCap) {
+        if (storage == STORAGE_MATRIX) {
+            int** grown = new int* [newCap];
+            for (int i = 0; i < newCap; i++) {
+                grown[i] = new int[newCap];
+                for (int j = 0; j < newCap; j++) {
+                    grown[i][j] = (i < vertexCap && j < vertexCap) ? adjMatrix[i][j] : 0;
+                }
+            }
+            freeMatrix();
+            adjMatrix = grown;
+        }
+        else if (storage == STORAGE_BITSET) {
+            int words = (newCap + 63) / 64;
+            size_t total = (size_t)newCap * words;
+            uint64_t* grown = new uint64_t[total];
+            for (size_t i = 0; i < total; i++) grown[i] = 0;
+            int rows = (vertexCap < newCap) ? vertexCap : newCap;
+            int copied = (rowWords < words) ? rowWords : words;
+            for (int u = 0; u < rows; u++) {
+                for (int w = 0; w < copied; w++) grown[(size_t)u * words + w] = bitRow(u)[w];
+            }
+            delete[] bits;
+            bits = grown;
+            rowWords = words;
+        }
+
+        bool* grownAlive = new bool[newCap];
+        for (int i = 0; i < newCap; i++) grownAlive[i] = (i < vertexCap) ? alive[i] : false;
+        delete[] alive;
+        alive = grownAlive;
+        vertexCap = newCap;
+    }
+
+    // Every edge touching one of vertices, as (u, v) pairs, read before
+    // any of them is written so the CSR snapshots are built only once
+    void collectIncident(const int* vertices, int count, IntBuffer& pairs) {
+        prepare();
+        for (int i = 0; i < count; i++) {
+            int v = vertices[i];
+            forEachNeighbor(v, [&](int x, int) {
+                pairs.push(v);
+                pairs.push(x);
+                if (!isDirected) {
+                    pairs.push(x);
+                    pairs.push(v);
+                }
+            });
+            if (isDirected) {
+                forEachInNeighbor(v, [&](int x, int) {
+                    pairs.push(x);
+                    pairs.push(v);
+                });
+            }
+        }
+    }
+
+    // Every change to vertices or edges comes through here
+    void markWritten() {
+        reverseValid = false;
+        version++;
+    }
+
+    // Cached result of this query on the unchanged graph, or NULL. Traced
+    // runs always recompute so the trace is recorded.
+    IntBuffer* cachedQuery(int kind, int a, int b) {
+        if (trace.isEnabled()) return NULL;
+        return cache.find(kind, a, b, version);
+    }
+
+    IntBuffer& remember(int kind, int a, int b, IntBuffer& result) {
+        if (!trace.isEnabled()) cache.store(kind, a, b, version, result);
+        return result;
+    }
+
+    void setWeight(int u, int v, int w) {
+        markWritten();
+        if (storage == STORAGE_MATRIX) {
+            adjMatrix[u][v] = w;
+        }
+        else if (storage == STORAGE_BITSET) {
+            uint64_t mask = (uint64_t)1 << (v & 63);
+            if (w != 0) bitRow(u)[v >> 6] |= mask;
+            else bitRow(u)[v >> 6] &= ~mask;
+        }
+        else {
+            csr->set(u, v, w);
+        }
+    }
+
+    // Reads must see a merged CSR; a no-op for the other backends
+    void prepare() {
+        if (storage == STORAGE_CSR) csr->build();
+    }
+
+    int weightOf(int u, int v) {
+        if (storage == STORAGE_MATRIX) return adjMatrix[u][v];
+        if (storage == STORAGE_BITSET) return hasBit(u, v) ? 1 : 0;
+        return csr->get(u, v);
+    }
+
+    // Calls visit(v, w) for each edge u -> v in increasing v. Matrix rows
+    // cost O(n), bitset rows O(n / 64 + deg(u)), CSR rows O(deg(u)).
+    // Callers run prepare() first.
+    template <typename Visit>
+    void forEachNeighbor(int u, Visit visit) {
+        if (storage == STORAGE_MATRIX) {
+            int* row = adjMatrix[u];
+            for (int v = 0; v < n; v++) {
+                if (row[v] != 0) visit(v, row[v]);
+            }
+        }
+        else if (storage == STORAGE_BITSET) {
+            uint64_t* row = bitRow(u);
+            for (int w = 0; w < rowWords; w++) {
+                uint64_t word = row[w];
+                while (word) {
+                    visit(w * 64 + __builtin_ctzll(word), 1);
+                    word &= word - 1;
+                }
+            }
+        }
+        else {
+            for (int e = csr->rowBegin(u); e < csr->rowEnd(u); e++) {
+                visit(csr->target(e), csr->weight(e));
+            }
+        }
+    }
+
+    // Same as forEachNeighbor, in decreasing v
+    template <typename Visit>
+    void forEachNeighborReverse(int u, Visit visit) {
+        if (storage == STORAGE_MATRIX) {
+            int* row = adjMatrix[u];
+            for (int v = n - 1; v >= 0; v--) {
+                if (row[v] != 0) visit(v, row[v]);
+            }
+        }
+        else if (storage == STORAGE_BITSET) {
+            uint64_t* row = bitRow(u);
+            for (int w = rowWords - 1; w >= 0; w--) {
+                uint64_t word = row[w];
+                while (word) {
+                    int b = 63 - __builtin_clzll(word);
+                    visit(w * 64 + b, 1);
+                    word &= ~((uint64_t)1 << b);
+                }
+            }
+        }
+        else {
+            for (int e = csr->rowEnd(u) - 1; e >= csr->rowBegin(u); e--) {
+                visit(csr->target(e), csr->weight(e));
+            }
+        }
+    }
+
+    // BFS in the same visit order as the generic one, but each dequeued
+    // vertex claims all its unvisited neighbours a word at a time:
+    // fresh = row & ~visited, visited |= fresh. SIMD128 does two words
+    // per step and skips all-zero pairs outright.
+    void bitsetBfs(int start) {
+        uint64_t* visited = new uint64_t[rowWords > 0 ? rowWords : 1];
+        for (int w = 0; w < rowWords; w++) visited[w] = 0;
+
+        output.reserve(n);
+        int* queue = output.data; // each vertex is queued once: output is the queue
+        int head = 0;
+        int tail = 0;
+        visited[start >> 6] |= (uint64_t)1 << (start & 63);
+        queue[tail++] = start;
+
+        while (head < tail) {
+            uint64_t* row = bitRow(queue[head++]);
+            int w = 0;
+#ifdef __wasm_simd128__
+            for (; w + 2 <= rowWords; w += 2) {
+                v128_t fresh = wasm_v128_andnot(wasm_v128_load(row + w), wasm_v128_load(visited + w));
+                if (!wasm_v128_any_true(fresh)) continue;
+                wasm_v128_store(visited + w, wasm_v128_or(wasm_v128_load(visited + w), fresh));
+                uint64_t lo = wasm_i64x2_extract_lane(fresh, 0);
+                uint64_t hi = wasm_i64x2_extract_lane(fresh, 1);
+                while (lo) {
+                    queue[tail++] = w * 64 + __builtin_ctzll(lo);
+                    lo &= lo - 1;
+                }
+                while (hi) {
+                    queue[tail++] = (w + 1) * 64 + __builtin_ctzll(hi);
+                    hi &= hi - 1;
+                }
+            }
+#endif
+            for (; w < rowWords; w++) {
+                uint64_t fresh = row[w] & ~visited[w];
+                if (!fresh) continue;
+                visited[w] |= fresh;
+                while (fresh) {
+                    queue[tail++] = w * 64 + __builtin_ctzll(fresh);
+                    fresh &= fresh - 1;
+                }
+            }
+        }
+
+        output.size = tail;
+        delete[] visited;
+    }
+
+    // Each undirected edge once, as (u, v, w) with u < v, in (u, v) order
+    void collectUndirectedEdges(IntBuffer& edges) {
+        prepare();
+        for (int u = 0; u < n; u++) {
+            forEachNeighbor(u, [&](int v, int w) {
+                if (u < v) {
+                    edges.push(u);
+                    edges.push(v);
+                    edges.push(w);
+                }
+            });
+        }
+    }
+
+    // Stable LSD radix sort of edge indices by weight: two 16-bit passes
+    // over the sign-flipped weight, O(m) for any int weights
+    void sortEdgesByWeight(const IntBuffer& edges, int* order) {
+        int m = edges.size / 3;
+        int* tmp = new int[m > 0 ? m : 1];
+        int* count = new int[65536 + 1];
+        for (int i = 0; i < m; i++) order[i] = i;
+
+        for (int shift = 0; shift < 32; shift += 16) {
+            for (int i = 0; i <= 65536; i++) count[i] = 0;
+            for (int i = 0; i < m; i++) {
+                unsigned int key = (unsigned int)edges.data[order[i] * 3 + 2] ^ 0x80000000u;
+                count[((key >> shift) & 0xFFFF) + 1]++;
+            }
+            for (int i = 0; i < 65536; i++) count[i + 1] += count[i];
+            for (int i = 0; i < m; i++) {
+                unsigned int key = (unsigned int)edges.data[order[i] * 3 + 2] ^ 0x80000000u;
+                tmp[count[(key >> shift) & 0xFFFF]++] = order[i];
+            }
+            for (int i = 0; i < m; i++) order[i] = tmp[i];
+        }
+
+        delete[] tmp;
+        delete[] count;
+    }
+
+    // Cheapest-edge key: weight in the high half (sign bit flipped so
+    // unsigned order matches signed), edge index in the low half. Lower
+    // keys win, so ties go to the lowest index and atomicMin picks the
+    // same edge whatever order the workers run in.
+    static uint64_t boruvkaKey(int weight, int e) {
+        return ((uint64_t)((uint32_t)weight ^ 0x80000000u) << 32) | (uint32_t)e;
+    }
+
+    // One Boruvka pass over edges [begin, end): for each component keep
+    // the cheapest edge leaving it. Safe to run on disjoint ranges at once.
+    void boruvkaScan(const IntBuffer& edges, int begin, int end,
+        const int* component, uint64_t* cheapest) {
+        for (int e = begin; e < end; e++) {
+            const int* edge = edges.data + e * 3;
+            int cu = component[edge[0]];
+            int cv = component[edge[1]];
+            if (cu == cv) continue;
+            uint64_t key = boruvkaKey(edge[2], e);
+            atomicMin(&cheapest[cu], key);
+            atomicMin(&cheapest[cv], key);
+        }
+    }
+
+    // Transposed CSR (row v lists the u with an edge u -> v), rebuilt in
+    // O(n + m) after writes. Undirected graphs never need it.
+    CSR* incoming() {
+        if (reverse != NULL && reverseValid) return reverse;
+        delete reverse;
+        reverse = new CSR(n);
+        prepare();
+        for (int u = 0; u < n; u++) {
+            forEachNeighbor(u, [&](int v, int w) {
+                reverse->set(v, u, w);
+            });
+        }
+        reverse->build();
+        reverseValid = true;
+        return reverse;
+    }
+
+    // visit(u, w) for every edge u -> v
+    template <typename Visit>
+    void forEachInNeighbor(int v, Visit visit) {
+        if (!isDirected) {
+            forEachNeighbor(v, visit);
+            return;
+        }
+        if (storage == STORAGE_MATRIX) {
+            for (int u = 0; u < n; u++) {
+                if (adjMatrix[u][v] != 0) visit(u, adjMatrix[u][v]);
+            }
+            return;
+        }
+        if (storage == STORAGE_BITSET) {
+            for (int u = 0; u < n; u++) {
+                if (hasBit(u, v)) visit(u, 1);
+            }
+            return;
+        }
+        CSR* in = incoming();
+        for (int e = in->rowBegin(v); e < in->rowEnd(v); e++) {
+            visit(in->target(e), in->weight(e));
+        }
+    }
+
+    void prepareSearch() {
+        prepare();
+        if (forward == NULL || forward->getCapacity() != (n > 0 ? n : 1)) {
+            delete forward;
+            delete backward;
+            forward = new SearchFrontier(n);
+            backward = new SearchFrontier(n);
+        }
+        forward->reset();
+        backward->reset();
+    }
+
+    // Appends source..meet from forward's tree, then meet..target from
+    // backward's (whose parents point towards the target)
+    void emitPath(int meet, bool hasBackward) {
+        for (int v = meet; v != -1; v = forward->parentOf(v)) output.push(v);
+        reverseBuffer(output);
+        if (hasBackward) {
+            for (int v = backward->parentOf(meet); v != -1; v = backward->parentOf(v)) output.push(v);
+        }
+    }
+
+    // A* from source to target under the estimate h(v); keys are g + h.
+    // Settled vertices are reopened if a shorter route turns up, so an
+    // admissible but inconsistent h still yields a shortest path.
+    template <typename Estimate>
+    void aStarSearch(int source, int target, Estimate h) {
+        SearchFrontier& f = *forward;
+        f.improve(source, 0, -1);
+        f.open.push(source, h(source));
+
+        while (!f.open.empty()) {
+            int u = f.open.pop().vertex;
+            int du = f.distance(u);
+            trace.record(TRACE_VISIT, u, f.parentOf(u), du);
+            if (u == target) break;
+            f.close(u);
+
+            forEachNeighbor(u, [&](int v, int weight) {
+                if (f.improve(v, du + weight, u)) {
+                    f.open.push(v, du + weight + h(v));
+                    trace.record(TRACE_RELAX, u, v, du + weight);
+                }
+            });
+        }
+
+        pathDistance = f.distance(target);
+        if (pathDistance < 999999) emitPath(target, false);
+    }
+
+    static bool testBit(const uint64_t* set, int v) {
+        return (set[v >> 6] >> (v & 63)) & 1;
+    }
+
+    // Bottom-up step for one vertex: is any in-neighbour of v in the
+    // frontier? Stops at the first hit. Undirected bitset rows are ANDed
+    // with the frontier a word at a time.
+    bool hasParentIn(int v, const uint64_t* frontier, int words, long long& checks) {
+        if (!isDirected && storage == STORAGE_BITSET) {
+            uint64_t* row = bitRow(v);
+            for (int w = 0; w < words; w++) {
+                checks++;
+                if (row[w] & frontier[w]) return true;
+            }
+            return false;
+        }
+        if (storage == STORAGE_MATRIX) {
+            for (int u = 0; u < n; u++) {
+                int weight = isDirected ? adjMatrix[u][v] : adjMatrix[v][u];
+                if (weight != 0) {
+                    checks++;
+                    if (testBit(frontier, u)) return true;
+                }
+            }
+            return false;
+        }
+
+        CSR* in = isDirected ? incoming() : csr;
+        for (int e = in->rowBegin(v); e < in->rowEnd(v); e++) {
+            checks++;
+            if (testBit(frontier, in->target(e))) return true;
+        }
+        return false;
+    }
+
+public:
+    Graph(int vertices, bool directed = false, int mode = STORAGE_AUTO)
+        : n(vertices), deadCount(0), compactions(0), adjMatrix(NULL), csr(NULL),
+        bits(NULL), rowWords(0), isDirected(directed), reverse(NULL), reverseValid(false), version(0),
+        forward(NULL), backward(NULL), coords(NULL), coordCount(0), heuristicScale(1.0f),
+        heuristic(HEURISTIC_EUCLIDEAN), pathDistance(999999) {
+        if (n < 0) n = 0;
+        if (mode == STORAGE_AUTO || mode < STORAGE_AUTO || mode > STORAGE_BITSET) {
+            mode = (n <= MATRIX_AUTO_LIMIT) ? STORAGE_MATRIX : STORAGE_CSR;
+        }
+        storage = mode;
+        vertexCap = n;
+        alive = new bool[n > 0 ? n : 1];
+        for (int i = 0; i < n; i++) alive[i] = true;
+        allocStorage();
+    }
+
+    ~Graph() {
+        freeStorage();
+        delete[] alive;
+        delete reverse;
+        delete forward;
+        delete backward;
+        delete[] coords;
+    }
+
+    void addEdge(int u, int v, int w = 1) {
+        if (isAlive(u) && isAlive(v)) {
+            setWeight(u, v, w);
+            if (!isDirected && u != v) {
+                setWeight(v, u, w);
+            }
+        }
+    }
+
+    void removeEdge(int u, int v) {
+        if (u >= 0 && u < n && v >= 0 && v < n) {
+            setWeight(u, v, 0);
+            if (!isDirected) {
+                setWeight(v, u, 0);
+            }
+        }
+    }
+
+    // Flat (u, v, w) triples; a trailing partial triple is ignored
+    void addEdges(const int* triples, int count) {
+        for (int i = 0; i + 2 < count; i += 3) {
+            addEdge(triples[i], triples[i + 1], triples[i + 2]);
+        }
+    }
+
+    // Flat (u, v) pairs
+    void removeEdges(const int* pairs, int count) {
+        for (int i = 0; i + 1 < count; i += 2) {
+            removeEdge(pairs[i], pairs[i + 1]);
+        }
+    }
+
+    void setDirected(bool directed) {
+        isDirected = directed;
+        markWritten();
+        if (!directed) {
+            if (storage == STORAGE_MATRIX) {
+                for (int i = 0; i < n; i++) {
+                    for (int j = i + 1; j < n; j++) {
+                        if (adjMatrix[i][j] != 0 || adjMatrix[j][i] != 0) {
+                            int weight = (adjMatrix[i][j] != 0) ? adjMatrix[i][j] : adjMatrix[j][i];
+                            adjMatrix[i][j] = weight;
+                            adjMatrix[j][i] = weight;
+                        }
+                    }
+                }
+            }
+            else if (storage == STORAGE_BITSET) {
+                for (int i = 0; i < n; i++) {
+                    for (int j = i + 1; j < n; j++) {
+                        if (hasBit(i, j) || hasBit(j, i)) {
+                            setWeight(i, j, 1);
+                            setWeight(j, i, 1);
+                        }
+                    }
+                }
+            }
+            else {
+                // Same rule as the matrix: (i, j) with i < j wins over (j, i).
+                // Reads use the built snapshot, writes go to the log.
+                csr->build();
+                for (int u = 0; u < n; u++) {
+                    for (int e = csr->rowBegin(u); e < csr->rowEnd(u); e++) {
+                        int v = csr->target(e);
+                        if (u < v || csr->get(v, u) == 0) {
+                            csr->set(v, u, csr->weight(e));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    bool getIsDirected() {
+        return isDirected;
+    }
+
+    int getStorageMode() {
+        return storage;
+    }
+
+    // Converts between backends by streaming the edges through a scratch
+    // list: O(n^2) on the matrix side, O(n^2 / 64) bitset, O(n + m) CSR.
+    // Converting to STORAGE_BITSET drops weights (all edges become 1).
+    // STORAGE_AUTO picks CSR for large graphs or below 1/8 density.
+    void setStorageMode(int mode) {
+        if (mode == STORAGE_AUTO) {
+            long long cells = (long long)n * n;
+            bool sparse = (long long)getEdgeCount() * CSR_DENSITY_DIVISOR < cells;
+            mode = (n > MATRIX_AUTO_LIMIT || sparse) ? STORAGE_CSR : STORAGE_MATRIX;
+        }
+        if (mode == storage || mode < STORAGE_MATRIX || mode > STORAGE_BITSET) return;
+
+        IntBuffer edges;
+        prepare();
+        for (int u = 0; u < n; u++) {
+            forEachNeighbor(u, [&](int v, int w) {
+                edges.push(u);
+                edges.push(v);
+                edges.push(w);
+            });
+        }
+
+        freeStorage();
+        storage = mode;
+        allocStorage();
+        for (int i = 0; i + 2 < edges.size; i += 3) {
+            setWeight(edges.data[i], edges.data[i + 1], edges.data[i + 2]);
+        }
+        prepare();
+    }
+
+    // Number of stored directed entries (an undirected edge counts twice)
+    int getEdgeCount() {
+        if (storage == STORAGE_CSR) {
+            csr->build();
+            return csr->edges();
+        }
+        if (storage == STORAGE_BITSET) {
+            size_t words = (size_t)n * rowWords;
+            int count = 0;
+            for (size_t i = 0; i < words; i++) count += __builtin_popcountll(bits[i]);
+            return count;
+        }
+        int count = 0;
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                if (adjMatrix[i][j] != 0) count++;
+            }
+        }
+        return count;
+    }
+
+    bool isAlive(int vertex) {
+        return vertex >= 0 && vertex < n && alive[vertex];
+    }
+
+    // Vertices not removed; getVertexCount() also counts tombstoned ids
+    int getLiveVertexCount() {
+        return n - deadCount;
+    }
+
+    // Appends an isolated vertex and returns its id. Full matrix / bitset
+    // storage grows by half, so adds cost amortized O(n) / O(n / 64) each
+    // (O(1) for CSR) instead of a rebuild.
+    int addVertex() {
+        if (n == vertexCap) resizeCapacity(vertexCap + vertexCap / 2 + 8);
+        if (storage == STORAGE_CSR) csr->addVertex();
+        alive[n] = true;
+        markWritten();
+        return n++;
+    }
+
+    // Drops every edge touching vertex and tombstones its id, in O(deg)
+    // writes plus an O(n) column scan for directed matrix / bitset graphs.
+    // Ids never move on removal; only an explicit compact() renumbers them.
+    bool removeVertex(int vertex) {
+        return removeVertices(&vertex, 1) == 1;
+    }
+
+    // Batched removeVertex: the CSR snapshots are merged once for the whole
+    // batch. Returns how many vertices were removed.
+    int removeVertices(const int* vertices, int count) {
+        IntBuffer doomed;
+        for (int i = 0; i < count; i++) {
+            int v = vertices[i];
+            if (!isAlive(v)) continue;
+            alive[v] = false; // also skips duplicates in the batch
+            doomed.push(v);
+        }
+        if (doomed.size == 0) return 0;
+        markWritten();
+
+        IntBuffer pairs;
+        collectIncident(doomed.data, doomed.size, pairs);
+        for (int i = 0; i + 1 < pairs.size; i += 2) {
+            setWeight(pairs.data[i], pairs.data[i + 1], 0);
+        }
+        deadCount += doomed.size;
+        return doomed.size;
+    }
+
+    // Renumbers live vertices to 0..live-1 keeping their order and rebuilds
+    // the storage at that size: O(n + m) for CSR, O(n^2) matrix, O(n^2 / 64)
+    // bitset. Coordinates follow their vertices. Worth calling once
+    // getLiveVertexCount() is well below getVertexCount(); anything holding
+    // ids (a ForceLayout, indices in JS) must then remap via getIdMap().
+    void compact() {
+        idMap.clear();
+        idMap.reserve(n);
+        idMap.size = n;
+        int live = 0;
+        for (int v = 0; v < n; v++) idMap.data[v] = alive[v] ? live++ : -1;
+
+        IntBuffer edges;
+        prepare();
+        for (int u = 0; u < n; u++) {
+            forEachNeighbor(u, [&](int v, int w) {
+                edges.push(idMap.data[u]);
+                edges.push(idMap.data[v]);
+                edges.push(w);
+            });
+        }
+
+        if (coords != NULL) {
+            int kept = 0;
+            for (int v = 0; v < coordCount; v++) {
+                if (idMap.data[v] == -1) continue;
+                coords[kept * 2] = coords[v * 2];
+                coords[kept * 2 + 1] = coords[v * 2 + 1];
+                kept++;
+            }
+            coordCount = kept;
+        }
+
+        freeStorage();
+        n = live;
+        vertexCap = live;
+        delete[] alive;
+        alive = new bool[live > 0 ? live : 1];
+        for (int i = 0; i < live; i++) alive[i] = true;
+        deadCount = 0;
+        allocStorage();
+        for (int i = 0; i + 2 < edges.size; i += 3) {
+            setWeight(edges.data[i], edges.data[i + 1], edges.data[i + 2]);
+        }
+        prepare();
+        compactions++;
+        markWritten();
+    }
+
+    // Old id -> new id (-1 for removed) from the last compaction
+    IntBuffer& getIdMap() {
+        return idMap;
+    }
+
+    // Bumped by every compaction, so callers can tell their ids moved
+    int getCompactionCount() {
+        return compactions;
+    }
+
+    // Snapshot (see SNAPSHOTS) payload:
+    //   n, directed, storage mode, heuristic, heuristic scale,
+    //   coordCount, then coordCount (x, y) float pairs,
+    //   tombstone count, then the removed ids,
+    //   entry count, then (u, v, w) per stored entry (u <= v if undirected)
+    IntBuffer& serialize() {
+        SnapshotWriter out(snapshot, SNAPSHOT_GRAPH);
+        out.put(n);
+        out.put(isDirected ? 1 : 0);
+        out.put(storage);
+        out.put(heuristic);
+        out.putFloat(heuristicScale);
+        out.put(coords != NULL ? coordCount : 0);
+        for (int i = 0; coords != NULL && i < coordCount * 2; i++) out.putFloat(coords[i]);
+        out.put(deadCount);
+        for (int v = 0; v < n; v++) {
+            if (!alive[v]) out.put(v);
+        }
+
+        int entriesAt = out.mark();
+        int entries = 0;
+        prepare();
+        for (int u = 0; u < n; u++) {
+            forEachNeighbor(u, [&](int v, int w) {
+                if (!isDirected && v < u) return;
+                out.put(u);
+                out.put(v);
+                out.put(w);
+                entries++;
+            });
+        }
+        out.patch(entriesAt, entries);
+        return out.finish();
+    }
+
+    // Restores a serialize() result in O(n + m) for CSR (O(n^2) matrix,
+    // O(n^2 / 64) bitset). The whole payload is checked before anything is
+    // released, so a rejected snapshot leaves the graph as it was. Matrix
+    // and bitset graphs above their snapshot limits (a size only reached
+    // by growing them) come back in CSR storage, holding the same edges.
+    // Traversal scratch, traces and counters persist; the id map and
+    // compaction count start over.
+    bool deserialize(const int* words, int length) {
+        SnapshotReader in(words, length, SNAPSHOT_GRAPH);
+        int vertices = in.getCount(SNAPSHOT_MAX_VERTICES);
+        bool directed = in.get() != 0;
+        int mode = in.get();
+        int estimate = in.get();
+        float scale = in.getFloat();
+        if (!in.valid() || mode < STORAGE_MATRIX || mode > STORAGE_BITSET)
+            return false;
+        if ((mode == STORAGE_MATRIX && vertices > MATRIX_AUTO_LIMIT) ||
+            (mode == STORAGE_BITSET && vertices > BITSET_SNAPSHOT_LIMIT))
+            mode = STORAGE_CSR;
+
+        int positioned = in.getCount(vertices < in.remaining() / 2 ? vertices : in.remaining() / 2);
+        const int* xy = in.cursor();
+        for (int i = 0; i < positioned * 2; i++) in.get();
+        int dead = in.getCount(vertices < in.remaining() ? vertices : in.remaining());
+        if (!in.valid())
+            return false;
+
+        bool* live = new bool[vertices > 0 ? vertices : 1];
+        for (int i = 0; i < vertices; i++) live[i] = true;
+        bool ok = true;
+        for (int i = 0; i < dead && ok; i++) {
+            int v = in.get();
+            if (v < 0 || v >= vertices || !live[v]) ok = false;
+            else live[v] = false;
+        }
+        int entries = ok ? in.getCount(in.remaining() / 3) : 0;
+        const int* edges = in.cursor();
+        for (int i = 0; i < entries && ok; i++) {
+            int u = in.get();
+            int v = in.get();
+            int w = in.get();
+            if (u < 0 || u >= vertices || v < 0 || v >= vertices || !live[u] || !live[v] ||
+                w == 0 || (!directed && v < u))
+                ok = false;
+        }
+        if (!ok || !in.valid() || !in.atEnd()) {
+            delete[] live;
+            return false;
+        }
+
+        freeStorage();
+        delete reverse;
+        reverse = NULL;
+        markWritten();
+        delete[] coords;
+        coords = NULL;
+        coordCount = 0;
+        delete[] alive;
+        idMap.clear();
+        levels.clear();
+        compactions = 0;
+        pathDistance = 999999;
+
+        n = vertices;
+        vertexCap = n;
+        isDirected = directed;
+        storage = mode;
+        setHeuristic(estimate);
+        heuristicScale = (scale > 0.0f) ? scale : 0.0f;
+        alive = live;
+        deadCount = dead;
+        allocStorage();
+        if (positioned > 0) {
+            coords = new float[positioned * 2];
+            memcpy(coords, xy, (size_t)positioned * 2 * sizeof(float));
+            coordCount = positioned;
+        }
+        for (int i = 0; i < entries; i++) {
+            addEdge(edges[i * 3], edges[i * 3 + 1], edges[i * 3 + 2]);
+        }
+        prepare();
+        return true;
+    }
+
+    // Dense row-major n*n weights; empty for CSR and bitset graphs above
+    // MATRIX_AUTO_LIMIT
+    IntBuffer& exportMatrix() {
+        output.clear();
+        if (storage != STORAGE_MATRIX && n > MATRIX_AUTO_LIMIT)
+            return output;
+        prepare();
+
+        output.reserve(n * n);
+        for (int i = 0; i < n; i++) {
+            int e = (storage == STORAGE_CSR) ? csr->rowBegin(i) : 0;
+            for (int j = 0; j < n; j++) {
+                int w;
+                if (storage == STORAGE_MATRIX) {
+                    w = adjMatrix[i][j];
+                }
+                else if (storage == STORAGE_BITSET) {
+                    w = hasBit(i, j) ? 1 : 0;
+                }
+                else if (e < csr->rowEnd(i) && csr->target(e) == j) {
+                    w = csr->weight(e++);
+                }
+                else {
+                    w = 0;
+                }
+                output.push(w);
+            }
+        }
+        return output;
+    }
+
+    string getMatrix() {
+        exportMatrix();
+        if (output.size == 0)
+            return "[]";
+
+        string out = "[";
+        for (int i = 0; i < n; i++) {
+            out += formatList(output.data + i * n, n);
+            if (i < n - 1) out += ",";
+        }
+        out += "]";
+        return out;
+    }
+
+    // Visit order from start; empty for an invalid start
+    IntBuffer& bfsOrder(int start) {
+        IntBuffer* cached = cachedQuery(QUERY_BFS, start, 0);
+        if (cached) return *cached;
+
+        output.clear();
+        if (start < 0 || start >= n)
+            return output;
+
+        // The word-parallel path has no per-edge steps to trace
+        if (storage == STORAGE_BITSET && !trace.isEnabled()) {
+            bitsetBfs(start);
+            return remember(QUERY_BFS, start, 0, output);
+        }
+
+        prepare();
+        bool* visited = new bool[n];
+        for (int i = 0; i < n; i++) visited[i] = false;
+
+        Queue q;
+        visited[start] = true;
+        q.enqueue(start);
+
+        while (!q.empty()) {
+            int node = q.Front();
+            q.dequeue();
+            output.push(node);
+            trace.record(TRACE_VISIT, node, -1, 0);
+
+            forEachNeighbor(node, [&](int neighbor, int) {
+                if (!visited[neighbor]) {
+                    visited[neighbor] = true;
+                    q.enqueue(neighbor);
+                    trace.record(TRACE_RELAX, node, neighbor, 0);
+                }
+            });
+        }
+
+        delete[] visited;
+        return remember(QUERY_BFS, start, 0, output);
+    }
+
+    string bfs(int start) {
+        return formatList(bfsOrder(start));
+    }
+
+    // Direction-optimizing BFS (Beamer et al.): expands top-down while the
+    // frontier is small and switches to bottom-up, where each unvisited
+    // vertex looks for any parent in the frontier, once the frontier's
+    // edges exceed 1/ALPHA of the unexplored ones; it switches back when
+    // the frontier shrinks below n/BETA. Returns vertices level by level,
+    // ascending within a level; getLevels() describes each level.
+    IntBuffer& directionOptimizingBfsOrder(int start) {
+        static const int ALPHA = 14;
+        static const int BETA = 24;
+        static const int DEGREE_GRAIN = 1024;
+        static const int TOP_DOWN_GRAIN = 64;
+        static const int BOTTOM_UP_GRAIN = 64 * 64; // whole words of next
+
+        output.clear();
+        levels.clear();
+        if (start < 0 || start >= n)
+            return output;
+
+        prepare();
+        int words = (n + 63) / 64;
+        uint64_t* visited = new uint64_t[words];
+        uint64_t* frontier = new uint64_t[words];
+        uint64_t* next = new uint64_t[words];
+        int* degree = new int[n];
+        TaskPool& pool = TaskPool::shared();
+        int threads = pool.getThreadCount();
+        long long* workerSum = new long long[threads];
+        for (int w = 0; w < words; w++) visited[w] = frontier[w] = next[w] = 0;
+        for (int t = 0; t < threads; t++) workerSum[t] = 0;
+        pool.parallelFor(0, n, DEGREE_GRAIN, [&](int begin, int end, int worker) {
+            for (int u = begin; u < end; u++) {
+                if (storage == STORAGE_CSR) {
+                    degree[u] = csr->rowEnd(u) - csr->rowBegin(u);
+                }
+                else {
+                    degree[u] = 0;
+                    forEachNeighbor(u, [&](int, int) { degree[u]++; });
+                }
+                workerSum[worker] += degree[u];
+            }
+        });
+        long long unexploredEdges = 0;
+        for (int t = 0; t < threads; t++) unexploredEdges += workerSum[t];
+        // Build the transpose up front; workers only read it
+        if (isDirected && storage != STORAGE_MATRIX) incoming();
+
+        output.reserve(n);
+        visited[start >> 6] |= (uint64_t)1 << (start & 63);
+        output.push(start);
+        unexploredEdges -= degree[start];
+        int levelBegin = 0;
+        bool bottomUp = false;
+        levels.push(1);
+        levels.push(0);
+        levels.push(0);
+
+        while (levelBegin < output.size) {
+            int levelEnd = output.size;
+            long long frontierEdges = 0;
+            for (int w = 0; w < words; w++) frontier[w] = 0;
+            for (int i = levelBegin; i < levelEnd; i++) {
+                int u = output.data[i];
+                frontier[u >> 6] |= (uint64_t)1 << (u & 63);
+                frontierEdges += degree[u];
+            }
+
+            int frontierSize = levelEnd - levelBegin;
+            if (!bottomUp && frontierEdges * ALPHA > unexploredEdges) bottomUp = true;
+            else if (bottomUp && (long long)frontierSize * BETA < n) bottomUp = false;
+
+            for (int t = 0; t < threads; t++) workerSum[t] = 0;
+            if (bottomUp) {
+                // Chunks cover whole words, so each word of next has one writer
+                pool.parallelFor(0, n, BOTTOM_UP_GRAIN, [&](int begin, int end, int worker) {
+                    long long checks = 0;
+                    for (int v = begin; v < end; v++) {
+                        if (testBit(visited, v)) continue;
+                        if (hasParentIn(v, frontier, words, checks)) {
+                            next[v >> 6] |= (uint64_t)1 << (v & 63);
+                        }
+                    }
+                    workerSum[worker] += checks;
+                });
+            }
+            else {
+                pool.parallelFor(levelBegin, levelEnd, TOP_DOWN_GRAIN, [&](int begin, int end, int worker) {
+                    long long checks = 0;
+                    for (int i = begin; i < end; i++) {
+                        forEachNeighbor(output.data[i], [&](int v, int) {
+                            checks++;
+                            if (!testBit(visited, v)) {
+                                atomicOr(&next[v >> 6], (uint64_t)1 << (v & 63));
+                            }
+                        });
+                    }
+                    workerSum[worker] += checks;
+                });
+            }
+            long long checks = 0;
+            for (int t = 0; t < threads; t++) checks += workerSum[t];
+
+            // Emit the next level in ascending order and fold it into visited
+            for (int w = 0; w < words; w++) {
+                uint64_t word = next[w];
+                visited[w] |= word;
+                next[w] = 0;
+                while (word) {
+                    int v = w * 64 + __builtin_ctzll(word);
+                    output.push(v);
+                    unexploredEdges -= degree[v];
+                    word &= word - 1;
+                }
+            }
+
+            levelBegin = levelEnd;
+            if (output.size > levelEnd) {
+                levels.push(output.size - levelEnd);
+                levels.push(bottomUp ? 1 : 0);
+                levels.push((int)(checks > 2147483647LL ? 2147483647LL : checks));
+            }
+        }
+
+        delete[] visited;
+        delete[] frontier;
+        delete[] next;
+        delete[] degree;
+        delete[] workerSum;
+        return output;
+    }
+
+    string directionOptimizingBfs(int start) {
+        return formatList(directionOptimizingBfsOrder(start));
+    }
+
+    // Per level of the last directionOptimizingBfs: (vertices, direction
+    // that discovered it: 0 top-down / 1 bottom-up, edges checked to
+    // discover it). Level 0 is the start vertex, (1, 0, 0).
+    IntBuffer& getLevels() {
+        return levels;
+    }
+
+    IntBuffer& dfsOrder(int start) {
+        IntBuffer* cached = cachedQuery(QUERY_DFS, start, 0);
+        if (cached) return *cached;
+
+        output.clear();
+        if (start < 0 || start >= n)
+            return output;
+
+        prepare();
+        bool* visited = new bool[n];
+        for (int i = 0; i < n; i++) visited[i] = false;
+
+        Stack s;
+        s.push(start);
+
+        while (!s.empty()) {
+            int node = s.Top();
+            s.pop();
+
+            if (!visited[node]) {
+                visited[node] = true;
+                output.push(node);
+                trace.record(TRACE_VISIT, node, -1, 0);
+
+                forEachNeighborReverse(node, [&](int neighbor, int) {
+                    if (!visited[neighbor]) {
+                        s.push(neighbor);
+                        trace.record(TRACE_RELAX, node, neighbor, 0);
+                    }
+                });
+            }
+        }
+
+        delete[] visited;
+        return remember(QUERY_DFS, start, 0, output);
+    }
+
+    string dfs(int start) {
+        return formatList(dfsOrder(start));
+    }
+
+    // Distance to every vertex (999999 = unreachable)
+    IntBuffer& dijkstraDistances(int start) {
+        IntBuffer* cached = cachedQuery(QUERY_DIJKSTRA, start, 0);
+        if (cached) return *cached;
+
+        output.clear();
+        if (start < 0 || start >= n)
+            return output;
+
+        prepare();
+        output.reserve(n);
+        output.size = n;
+        int* dist = output.data;
+        bool* visited = new bool[n];
+        int* previous = new int[n]; // shortest-path tree parent, for the trace
+
+        for (int i = 0; i < n; i++) {
+            dist[i] = 999999;
+            visited[i] = false;
+            previous[i] = -1;
+        }
+
+        dist[start] = 0;
+        IndexedMinHeap pq(n);
+        pq.push(start, 0);
+        counters.add(COUNT_PUSH);
+
+        while (!pq.empty()) {
+            PQNode current = pq.pop();
+            int u = current.vertex;
+
+            if (visited[u]) continue;
+            visited[u] = true;
+            trace.record(TRACE_VISIT, u, previous[u], dist[u]);
+
+            int scanned = 0;
+            forEachNeighbor(u, [&](int v, int weight) {
+                scanned++;
+                if (!visited[v] && dist[u] + weight < dist[v]) {
+                    dist[v] = dist[u] + weight;
+                    previous[v] = u;
+                    pq.push(v, dist[v]);
+                    counters.add(COUNT_RELAX);
+                    counters.add(COUNT_PUSH);
+                    trace.record(TRACE_RELAX, u, v, dist[v]);
+                }
+            });
+            counters.add(COUNT_EDGE, scanned);
+        }
+
+        delete[] visited;
+        delete[] previous;
+        return remember(QUERY_DIJKSTRA, start, 0, output);
+    }
+
+    string dijkstra(int start) {
+        return formatList(dijkstraDistances(start));
+    }
+
+    // Delta-stepping SSSP, same distances as dijkstraDistances. Vertices
+    // sit in buckets of width delta; each bucket is settled by relaxing
+    // light edges (weight <= delta) in parallel rounds until it stays
+    // empty, then heavy edges once for everything it held. delta <= 0
+    // picks the mean edge weight. Negative weights fall back to Dijkstra.
+    IntBuffer& deltaSteppingDistances(int start, int delta) {
+        static const int RELAX_GRAIN = 64;
+
+        IntBuffer* cached = cachedQuery(QUERY_DELTA_STEPPING, start, delta);
+        if (cached) return *cached;
+
+        output.clear();
+        if (start < 0 || start >= n)
+            return output;
+
+        prepare();
+        long long totalWeight = 0;
+        long long edgeCount = 0;
+        bool negative = false;
+        for (int u = 0; u < n; u++) {
+            forEachNeighbor(u, [&](int, int weight) {
+                if (weight < 0) negative = true;
+                totalWeight += weight;
+                edgeCount++;
+            });
+        }
+        if (negative)
+            return dijkstraDistances(start);
+        if (delta <= 0) {
+            delta = edgeCount > 0 ? (int)(totalWeight / edgeCount) : 1;
+            if (delta < 1) delta = 1;
+        }
+
+        output.reserve(n);
+        output.size = n;
+        int* dist = output.data;
+        int* inBucket = new int[n];  // bucket holding the live entry, or -1
+        int* settledIn = new int[n]; // last bucket v was taken from
+        for (int i = 0; i < n; i++) {
+            dist[i] = 999999;
+            inBucket[i] = -1;
+            settledIn[i] = -1;
+        }
+
+        TaskPool& pool = TaskPool::shared();
+        int threads = pool.getThreadCount();
+        IntBuffer* updated = new IntBuffer[threads];
+        IntBuffer** buckets = NULL;
+        int bucketCount = 0;
+        IntBuffer current;
+        IntBuffer removed;
+
+        // Files every vertex whose distance dropped into its new bucket
+        auto place = [&](int v) {
+            int b = dist[v] / delta;
+            if (inBucket[v] == b) return;
+            if (b >= bucketCount) {
+                int grown = bucketCount == 0 ? 16 : bucketCount * 2;
+                while (grown <= b) grown *= 2;
+                IntBuffer** bigger = new IntBuffer*[grown];
+                for (int i = 0; i < grown; i++) bigger[i] = i < bucketCount ? buckets[i] : NULL;
+                delete[] buckets;
+                buckets = bigger;
+                bucketCount = grown;
+            }
+            if (buckets[b] == NULL) buckets[b] = new IntBuffer();
+            buckets[b]->push(v);
+            inBucket[v] = b;
+        };
+        auto relax = [&](const IntBuffer& from, bool light) {
+            pool.parallelFor(0, from.size, RELAX_GRAIN, [&](int begin, int end, int worker) {
+                for (int i = begin; i < end; i++) {
+                    int u = from.data[i];
+                    int du = atomicLoad(&dist[u]);
+                    forEachNeighbor(u, [&](int v, int weight) {
+                        if ((weight <= delta) != light) return;
+                        if (atomicMin(&dist[v], du + weight)) updated[worker].push(v);
+                    });
+                }
+            });
+            for (int t = 0; t < threads; t++) {
+                for (int i = 0; i < updated[t].size; i++) place(updated[t].data[i]);
+                updated[t].clear();
+            }
+        };
+
+        dist[start] = 0;
+        place(start);
+        for (int b = 0; b < bucketCount; b++) {
+            removed.clear();
+            while (buckets[b] != NULL && buckets[b]->size > 0) {
+                current.clear();
+                IntBuffer& bucket = *buckets[b];
+                for (int i = 0; i < bucket.size; i++) {
+                    int v = bucket.data[i];
+                    if (inBucket[v] != b) continue; // moved to a lower bucket
+                    inBucket[v] = -1;
+                    current.push(v);
+                    if (settledIn[v] != b) {
+                        settledIn[v] = b;
+                        removed.push(v);
+                    }
+                }
+                bucket.clear();
+                relax(current, true);
+            }
+            relax(removed, false);
+            if (buckets[b] != NULL) {
+                delete buckets[b];
+                buckets[b] = NULL;
+            }
+        }
+
+        for (int b = 0; b < bucketCount; b++) delete buckets[b];
+        delete[] buckets;
+        delete[] updated;
+        delete[] inBucket;
+        delete[] settledIn;
+        return remember(QUERY_DELTA_STEPPING, start, delta, output);
+    }
+
+    string deltaStepping(int start, int delta) {
+        return formatList(deltaSteppingDistances(start, delta));
+    }
+
+    // Point-to-point shortest path, searching forward from source and
+    // backward from target (over incoming edges) at once. Each step grows
+    // the side with the smaller radius; the search stops when the two
+    // radii together reach the best source-target route seen. Returns the
+    // path source..target (empty if unreachable); see getPathDistance().
+    IntBuffer& bidirectionalPath(int source, int target) {
+        output.clear();
+        pathDistance = 999999;
+        if (source < 0 || source >= n || target < 0 || target >= n)
+            return output;
+
+        prepareSearch();
+        if (isDirected && storage != STORAGE_MATRIX) incoming();
+        SearchFrontier& f = *forward;
+        SearchFrontier& b = *backward;
+        f.improve(source, 0, -1);
+        f.open.push(source, 0);
+        b.improve(target, 0, -1);
+        b.open.push(target, 0);
+        int best = (source == target) ? 0 : 999999;
+        int meet = (source == target) ? source : -1;
+
+        while (!f.open.empty() && !b.open.empty()) {
+            if (f.open.minKey() + b.open.minKey() >= best) break;
+            bool forwardStep = f.open.minKey() <= b.open.minKey();
+            SearchFrontier& side = forwardStep ? f : b;
+            SearchFrontier& other = forwardStep ? b : f;
+
+            int u = side.open.pop().vertex;
+            int du = side.distance(u);
+            side.close(u);
+            trace.record(TRACE_VISIT, u, side.parentOf(u), du);
+
+            auto relax = [&](int v, int weight) {
+                if (side.isClosed(v)) return;
+                if (side.improve(v, du + weight, u)) {
+                    side.open.push(v, du + weight);
+                    trace.record(TRACE_RELAX, forwardStep ? u : v, forwardStep ? v : u, du + weight);
+                }
+                int through = side.distance(v) + other.distance(v);
+                if (other.distance(v) < 999999 && through < best) {
+                    best = through;
+                    meet = v;
+                }
+            };
+            if (forwardStep) forEachNeighbor(u, relax);
+            else forEachInNeighbor(u, relax);
+        }
+
+        if (meet != -1) {
+            pathDistance = best;
+            emitPath(meet, true);
+        }
+        return output;
+    }
+
+    string bidirectionalDijkstra(int source, int target) {
+        return formatList(bidirectionalPath(source, target));
+    }
+
+    // Point-to-point A* guided by the heuristic chosen with setHeuristic();
+    // without coordinates (or HEURISTIC_NONE) it is plain Dijkstra with an
+    // early exit at target
+    IntBuffer& aStarPath(int source, int target) {
+        output.clear();
+        pathDistance = 999999;
+        if (source < 0 || source >= n || target < 0 || target >= n)
+            return output;
+
+        prepareSearch();
+        float scale = heuristicScale;
+        int known = coordCount; // vertices added later have no estimate
+        const float* xy = (target < known) ? coords : NULL;
+        float tx = xy ? xy[target * 2] : 0.0f;
+        float ty = xy ? xy[target * 2 + 1] : 0.0f;
+
+        if (xy != NULL && heuristic == HEURISTIC_EUCLIDEAN) {
+            aStarSearch(source, target, [&](int v) {
+                if (v >= known) return 0;
+                float dx = xy[v * 2] - tx;
+                float dy = xy[v * 2 + 1] - ty;
+                return (int)(scale * sqrtf(dx * dx + dy * dy));
+            });
+        }
+        else if (xy != NULL && heuristic == HEURISTIC_MANHATTAN) {
+            aStarSearch(source, target, [&](int v) {
+                if (v >= known) return 0;
+                return (int)(scale * (fabsf(xy[v * 2] - tx) + fabsf(xy[v * 2 + 1] - ty)));
+            });
+        }
+        else {
+            aStarSearch(source, target, [](int) { return 0; });
+        }
+        return output;
+    }
+
+    string aStar(int source, int target) {
+        return formatList(aStarPath(source, target));
+    }
+
+    // Length of the path last returned by bidirectionalPath / aStarPath,
+    // 999999 when there was none
+    int getPathDistance() {
+        return pathDistance;
+    }
+
+    // x0, y0, x1, y1, ... for every vertex (e.g. graphViz's layout).
+    // scale converts coordinate distance into weight units.
+    void setCoordinates(const float* xy, int length, float scale) {
+        delete[] coords;
+        coords = NULL;
+        coordCount = 0;
+        heuristicScale = (scale > 0.0f) ? scale : 0.0f;
+        if (length < n * 2 || n == 0)
+            return;
+        coords = new float[n * 2];
+        for (int i = 0; i < n * 2; i++) coords[i] = xy[i];
+        coordCount = n;
+    }
+
+    void setHeuristic(int mode) {
+        heuristic = (mode >= HEURISTIC_NONE && mode <= HEURISTIC_MANHATTAN) ? mode : HEURISTIC_NONE;
+    }
+
+    int getHeuristic() {
+        return heuristic;
+    }
+
+    // MST edges as (parent, child, weight) triples in the order Prim adds them
+    IntBuffer& primEdges() {
+        IntBuffer* cached = cachedQuery(QUERY_PRIM, 0, 0);
+        if (cached) return *cached;
+
+        output.clear();
+        if (isDirected || n == 0) {
+            return output;
+        }
+
+        prepare();
+        int* key = new int[n];
+        int* parent = new int[n];
+        bool* inMST = new bool[n];
+
+        for (int i = 0; i < n; i++) {
+            key[i] = 999999;
+            parent[i] = -1;
+            inMST[i] = false;
+        }
+
+        int root = 0;
+        while (root < n && !alive[root]) root++;
+        if (root == n) {
+            delete[] key;
+            delete[] parent;
+            delete[] inMST;
+            return output;
+        }
+
+        key[root] = 0;
+        IndexedMinHeap pq(n);
+        pq.push(root, 0);
+        counters.add(COUNT_PUSH);
+
+        while (!pq.empty()) {
+            PQNode current = pq.pop();
+            int u = current.vertex;
+
+            if (inMST[u]) continue;
+            inMST[u] = true;
+            trace.record(TRACE_VISIT, u, parent[u], key[u]);
+
+            if (parent[u] != -1) {
+                output.push(parent[u]);
+                output.push(u);
+                output.push(key[u]);
+            }
+
+            int scanned = 0;
+            forEachNeighbor(u, [&](int v, int weight) {
+                scanned++;
+                if (!inMST[v] && weight < key[v]) {
+                    key[v] = weight;
+                    parent[v] = u;
+                    pq.push(v, key[v]);
+                    counters.add(COUNT_RELAX);
+                    counters.add(COUNT_PUSH);
+                    trace.record(TRACE_RELAX, u, v, weight);
+                }
+            });
+            counters.add(COUNT_EDGE, scanned);
+        }
+
+        delete[] key;
+        delete[] parent;
+        delete[] inMST;
+        return remember(QUERY_PRIM, 0, 0, output);
+    }
+
+    string primMST() {
+        return formatEdgeList(primEdges());
+    }
+
+    // Kruskal over the undirected edge list sorted by weight. Returns the
+    // minimum spanning forest as (u, v, w) triples in the order added.
+    IntBuffer& kruskalEdges() {
+        IntBuffer* cached = cachedQuery(QUERY_KRUSKAL, 0, 0);
+        if (cached) return *cached;
+
+        output.clear();
+        if (isDirected || n == 0) {
+            return output;
+        }
+
+        IntBuffer edges;
+        collectUndirectedEdges(edges);
+        int m = edges.size / 3;
+        int* order = new int[m > 0 ? m : 1];
+        sortEdgesByWeight(edges, order);
+
+        UnionFind sets(n);
+        for (int i = 0; i < m && output.size / 3 < n - 1; i++) {
+            const int* e = edges.data + order[i] * 3;
+            bool joined = sets.unite(e[0], e[1]);
+            trace.record(TRACE_COMPARE, e[0], e[1], joined ? 1 : 0);
+            if (joined) {
+                output.push(e[0]);
+                output.push(e[1]);
+                output.push(e[2]);
+            }
+        }
+
+        delete[] order;
+        return remember(QUERY_KRUSKAL, 0, 0, output);
+    }
+
+    string kruskalMST() {
+        return formatEdgeList(kruskalEdges());
+    }
+
+    // Boruvka: every round each component picks its cheapest outgoing edge
+    // and all of them are merged at once, so O(log n) rounds of O(m).
+    // Ties break on edge index, which keeps the picked edges acyclic.
+    IntBuffer& boruvkaEdges() {
+        IntBuffer* cached = cachedQuery(QUERY_BORUVKA, 0, 0);
+        if (cached) return *cached;
+
+        output.clear();
+        if (isDirected || n == 0) {
+            return output;
+        }
+
+        IntBuffer edges;
+        collectUndirectedEdges(edges);
+        int m = edges.size / 3;
+
+        static const uint64_t NO_EDGE = ~(uint64_t)0;
+        static const int SCAN_GRAIN = 4096;
+
+        UnionFind sets(n);
+        int* component = new int[n];
+        uint64_t* cheapest = new uint64_t[n];
+        int components = n;
+        bool merged = true;
+
+        while (components > 1 && merged) {
+            for (int v = 0; v < n; v++) {
+                component[v] = sets.find(v);
+                cheapest[v] = NO_EDGE;
+            }
+            TaskPool::shared().parallelFor(0, m, SCAN_GRAIN, [&](int begin, int end, int) {
+                boruvkaScan(edges, begin, end, component, cheapest);
+            });
+
+            merged = false;
+            for (int c = 0; c < n; c++) {
+                if (cheapest[c] == NO_EDGE) continue;
+                int e = (int)(uint32_t)cheapest[c];
+                const int* edge = edges.data + e * 3;
+                if (sets.unite(edge[0], edge[1])) {
+                    output.push(edge[0]);
+                    output.push(edge[1]);
+                    output.push(edge[2]);
+                    components--;
+                    merged = true;
+                }
+            }
+        }
+
+        delete[] component;
+        delete[] cheapest;
+        return remember(QUERY_BORUVKA, 0, 0, output);
+    }
+
+    string boruvkaMST() {
+        return formatEdgeList(boruvkaEdges());
+    }
+
+    void clear() {
+        markWritten();
+        if (storage == STORAGE_CSR) {
+            csr->clear();
+            return;
+        }
+        if (storage == STORAGE_BITSET) {
+            size_t words = (size_t)n * rowWords;
+            for (size_t i = 0; i < words; i++) bits[i] = 0;
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                adjMatrix[i][j] = 0;
+            }
+        }
+    }
+
+    int getVertexCount() {
+        return n;
+    }
+
+    // Step tracing (see TRACE BUFFER); capacity in events, 0 turns it off
+    void enableTrace(int capacity) {
+        trace.enable(capacity);
+    }
+
+    void disableTrace() {
+        trace.disable();
+    }
+
+    void clearTrace() {
+        trace.clear();
+    }
+
+    int getTraceDropped() {
+        return trace.getDropped();
+    }
+
+    IntBuffer& exportTrace() {
+        return trace.exportEvents();
+    }
+
+    // Work totals (see OP COUNTERS)
+    void resetCounters() {
+        counters.reset();
+    }
+
+    IntBuffer& exportCounters() {
+        return counters.exportValues();
+    }
+
+    // Bumped by every change to vertices or edges (see QUERY CACHE)
+    unsigned int getVersion() {
+        return version;
+    }
+
+    // Results kept for repeated bfs, dfs, dijkstra, delta-stepping and MST
+    // queries on an unchanged graph (default 8, at most 32; 0 turns the
+    // cache off). A hit returns the kept buffer without recomputing.
+    void setCacheCapacity(int entries) {
+        cache.setCapacity(entries);
+    }
+
+    int getCacheCapacity() {
+        return cache.getCapacity();
+    }
+
+    void clearCache() {
+        cache.clear();
+    }
+
+    int getCacheHits() {
+        return cache.getHits();
+    }
+
+    int getCacheMisses() {
+        return cache.getMisses();
+    }
+
+    // Bytes owned by the graph: the object, its edge storage (with the
+    // room reserved for vertexCap ids), the transposed CSR, point-to-point
+    // scratch, coordinates, cached results and export buffers
+    size_t memoryUsage() const {
+        size_t bytes = sizeof(*this) + (size_t)(vertexCap > 0 ? vertexCap : 1) * sizeof(bool);
+        if (adjMatrix != NULL) {
+            bytes += (size_t)vertexCap * (sizeof(int*) + (size_t)vertexCap * sizeof(int));
+        }
+        if (bits != NULL) {
+            size_t words = (size_t)vertexCap * rowWords;
+            bytes += (words > 0 ? words : 1) * sizeof(uint64_t);
+        }
+        if (csr != NULL) bytes += sizeof(CSR) + csr->heapBytes();
+        if (reverse != NULL) bytes += sizeof(CSR) + reverse->heapBytes();
+        if (forward != NULL) {
+            bytes += 2 * sizeof(SearchFrontier) + forward->heapBytes() + backward->heapBytes();
+        }
+        if (coords != NULL) bytes += (size_t)coordCount * 2 * sizeof(float);
+        return bytes + cache.heapBytes() + idMap.heapBytes() + output.heapBytes() +
+            levels.heapBytes() + trace.heapBytes() + counters.heapBytes() +
+            snapshot.heapBytes();
+    }
+
+    // Releases slack after large deletions: matrix / bitset storage is
+    // reallocated at n ids, CSR arrays are trimmed to the edges left, and
+    // the transposed CSR, search scratch, cached results and export
+    // buffers are freed (all are rebuilt on demand). Edges and ids are
+    // unchanged; run compact() first to drop tombstoned ids as well.
+    void shrinkToFit() {
+        if (vertexCap > n) resizeCapacity(n);
+        if (csr != NULL) csr->shrinkToFit();
+        delete reverse;
+        reverse = NULL;
+        reverseValid = false;
+        delete forward;
+        delete backward;
+        forward = backward = NULL;
+        if (coords != NULL && coordCount > 0) {
+            float* fitted = new float[coordCount * 2];
+            for (int i = 0; i < coordCount * 2; i++) fitted[i] = coords[i];
+            delete[] coords;
+            coords = fitted;
+        }
+        cache.clear();
+        output.release();
+        levels.release();
+        trace.shrink();
+        counters.shrink();
+        snapshot.release();
+    }
+};
+
+// ===================== GRAPH ITERATORS =====================
+// Resumable BFS / DFS / Dijkstra over a Graph: next() yields one vertex at
+// a time in the same order as bfsOrder / dfsOrder / dijkstraDistances'
+// settle order, advance(k) up to k of them. stopAt(target) ends the walk
+// once target is yielded, and pathTo(v) rebuilds the route to any vertex
+// reached so far. State is per-vertex bookkeeping plus the frontier; no
+// output accumulates between calls. The graph must outlive the iterator
+// and must not be edited while it runs.
+class BfsIterator {
+private:
+    Graph& graph;
+    int* parent; // -2 = not reached, -1 = start
+    int vertices; // length of parent
+    Queue frontier;
+    int target;
+    bool finished;
+    IntBuffer output;
+    IntBuffer route;
+
+    BfsIterator(const BfsIterator&);
+    BfsIterator& operator=(const BfsIterator&);
+
+public:
+    BfsIterator(Graph& g, int start)
+        : graph(g), parent(NULL), vertices(0), target(-1), finished(true) {
+        int n = graph.n;
+        if (start < 0 || start >= n)
+            return;
+        graph.prepare();
+        parent = new int[n];
+        vertices = n;
+        for (int i = 0; i < n; i++) parent[i] = -2;
+        parent[start] = -1;
+        frontier.enqueue(start);
+        finished = false;
+    }
+
+    ~BfsIterator() {
+        delete[] parent;
+    }
+
+    // Next vertex, or -1 once the walk is over
+    int next() {
+        if (finished)
+            return -1;
+        int node = frontier.Front();
+        frontier.dequeue();
+        graph.trace.record(TRACE_VISIT, node, parent[node], 0);
+
+        if (node != target) {
+            graph.forEachNeighbor(node, [&](int neighbor, int) {
+                if (parent[neighbor] == -2) {
+                    parent[neighbor] = node;
+                    frontier.enqueue(neighbor);
+                    graph.trace.record(TRACE_RELAX, node, neighbor, 0);
+                }
+            });
+        }
+        if (node == target || frontier.empty()) finished = true;
+        return node;
+    }
+
+    // Up to steps further vertices; fewer (or none) at the end
+    IntBuffer& advance(int steps) {
+        output.clear();
+        while (steps-- > 0 && !finished) output.push(next());
+        return output;
+    }
+
+    string step(int steps) {
+        return formatList(advance(steps));
+    }
+
+    void stopAt(int vertex) {
+        target = vertex;
+    }
+
+    bool isDone() {
+        return finished;
+    }
+
+    // Start-to-v route through the BFS tree, empty if v is not reached yet
+    IntBuffer& pathTo(int v) {
+        route.clear();
+        if (parent == NULL || v < 0 || v >= graph.n || parent[v] == -2)
+            return route;
+        for (int u = v; u != -1; u = parent[u]) route.push(u);
+        reverseBuffer(route);
+        return route;
+    }
+
+    string path(int v) {
+        return formatList(pathTo(v));
+    }
+
+    // Bytes owned by the walk: the object, the parent array, the queue's
+    // pool and the export buffers (the graph is not included)
+    size_t memoryUsage() const {
+        return sizeof(*this) + (size_t)vertices * sizeof(int) + frontier.heapBytes() +
+            output.heapBytes() + route.heapBytes();
+    }
+};
+
+class DfsIterator {
+private:
+    Graph& graph;
+    int* parent; // -2 = not visited, -1 = start
+    int vertices; // length of parent
+    Stack pending; // (vertex, parent) pairs, vertex on top
+    int target;
+    bool finished;
+    IntBuffer output;
+    IntBuffer route;
+
+    DfsIterator(const DfsIterator&);
+    DfsIterator& operator=(const DfsIterator&);
+
+    // Drops entries whose vertex was visited since it was pushed
+    void skipVisited() {
+        while (!pending.empty() && parent[pending.Top()] != -2) {
+            pending.pop();
+            pending.pop();
+        }
+        if (pending.empty()) finished = true;
+    }
+
+public:
+    DfsIterator(Graph& g, int start)
+        : graph(g), parent(NULL), vertices(0), target(-1), finished(true) {
+        int n = graph.n;
+        if (start < 0 || start >= n)
+            return;
+        graph.prepare();
+        parent = new int[n];
+        vertices = n;
+        for (int i = 0; i < n; i++) parent[i] = -2;
+        pending.push(-1);
+        pending.push(start);
+        finished = false;
+    }
+
+    ~DfsIterator() {
+        delete[] parent;
+    }
+
+    int next() {
+        if (finished)
+            return -1;
+        int node = pending.Top();
+        pending.pop();
+        parent[node] = pending.Top();
+        pending.pop();
+        graph.trace.record(TRACE_VISIT, node, parent[node], 0);
+
+        if (node == target) {
+            finished = true;
+            return node;
+        }
+        graph.forEachNeighborReverse(node, [&](int neighbor, int) {
+            if (parent[neighbor] == -2) {
+                pending.push(node);
+                pending.push(neighbor);
+                graph.trace.record(TRACE_RELAX, node, neighbor, 0);
+            }
+        });
+        skipVisited();
+        return node;
+    }
+
+    IntBuffer& advance(int steps) {
+        output.clear();
+        while (steps-- > 0 && !finished) output.push(next());
+        return output;
+    }
+
+    string step(int steps) {
+        return formatList(advance(steps));
+    }
+
+    void stopAt(int vertex) {
+        target = vertex;
+    }
+
+    bool isDone() {
+        return finished;
+    }
+
+    // Start-to-v route through the DFS tree, empty if v is not visited yet
+    IntBuffer& pathTo(int v) {
+        route.clear();
+        if (parent == NULL || v < 0 || v >= graph.n || parent[v] == -2)
+            return route;
+        for (int u = v; u != -1; u = parent[u]) route.push(u);
+        reverseBuffer(route);
+        return route;
+    }
+
+    string path(int v) {
+        return formatList(pathTo(v));
+    }
+
+    // Bytes owned by the walk: the object, the parent array, the stack's
+    // pool and the export buffers (the graph is not included)
+    size_t memoryUsage() const {
+        return sizeof(*this) + (size_t)vertices * sizeof(int) + pending.heapBytes() +
+            output.heapBytes() + route.heapBytes();
+    }
+};
+
+class DijkstraIterator {
+private:
+    Graph& graph;
+    int* dist;   // 999999 = not reached
+    int* parent; // -1 for the start and unreached vertices
+    bool* settled;
+    int vertices; // length of dist / parent / settled
+    IndexedMinHeap frontier;
+    int target;
+    bool finished;
+    IntBuffer output;
+    IntBuffer route;
+
+    DijkstraIterator(const DijkstraIterator&);
+    DijkstraIterator& operator=(const DijkstraIterator&);
+
+public:
+    DijkstraIterator(Graph& g, int start)
+        : graph(g), dist(NULL), parent(NULL), settled(NULL), vertices(0),
+        frontier(g.n > 0 ? g.n : 1), target(-1), finished(true) {
+        int n = graph.n;
+        if (start < 0 || start >= n)
+            return;
+        graph.prepare();
+        dist = new int[n];
+        parent = new int[n];
+        settled = new bool[n];
+        vertices = n;
+        for (int i = 0; i < n; i++) {
+            dist[i] = 999999;
+            parent[i] = -1;
+            settled[i] = false;
+        }
+        dist[start] = 0;
+        frontier.push(start, 0);
+        finished = false;
+    }
+
+    ~DijkstraIterator() {
+        delete[] dist;
+        delete[] parent;
+        delete[] settled;
+    }
+
+    // Settles and returns the closest unsettled vertex, -1 when done
+    int next() {
+        if (finished)
+            return -1;
+        int u = frontier.pop().vertex;
+        settled[u] = true;
+        graph.trace.record(TRACE_VISIT, u, parent[u], dist[u]);
+
+        if (u != target) {
+            graph.forEachNeighbor(u, [&](int v, int weight) {
+                if (!settled[v] && dist[u] + weight < dist[v]) {
+                    dist[v] = dist[u] + weight;
+                    parent[v] = u;
+                    frontier.push(v, dist[v]);
+                    graph.trace.record(TRACE_RELAX, u, v, dist[v]);
+                }
+            });
+        }
+        if (u == target || frontier.empty()) finished = true;
+        return u;
+    }
+
+    IntBuffer& advance(int steps) {
+        output.clear();
+        while (steps-- > 0 && !finished) output.push(next());
+        return output;
+    }
+
+    string step(int steps) {
+        return formatList(advance(steps));
+    }
+
+    void stopAt(int vertex) {
+        target = vertex;
+    }
+
+    bool isDone() {
+        return finished;
+    }
+
+    // Final once v is settled, a tentative upper bound before that
+    int getDistance(int v) {
+        if (dist == NULL || v < 0 || v >= graph.n)
+            return 999999;
+        return dist[v];
+    }
+
+    // Shortest route to a settled v (tentative route otherwise)
+    IntBuffer& pathTo(int v) {
+        route.clear();
+        if (dist == NULL || v < 0 || v >= graph.n || dist[v] == 999999)
+            return route;
+        for (int u = v; u != -1; u = parent[u]) route.push(u);
+        reverseBuffer(route);
+        return route;
+    }
+
+    string path(int v) {
+        return formatList(pathTo(v));
+    }
+
+    // Bytes owned by the walk: the object, the per-vertex arrays, the
+    // priority queue and the export buffers (the graph is not included)
+    size_t memoryUsage() const {
+        return sizeof(*this) + (size_t)vertices * (2 * sizeof(int) + sizeof(bool)) +
+            frontier.heapBytes() + output.heapBytes() + route.heapBytes();
+    }
+};
+
+// ===================== GRAPH LOADER =====================
+// Streaming import of edge-list text (SNAP style: "u v [w]" per line,
+// '#' or '%' comments, spaces, tabs or commas between fields) and Matrix
+// Market coordinate files into a Graph's CSR storage. feed() takes the
+// text in chunks of any size and only ever buffers one partial line;
+// edges go straight into the CSR write log and are merged once by
+// finish(). Edge-list ids are used as they are, Matrix Market ids are
+// 1-based; the graph grows to the largest id seen, so ids (and matrix
+// sizes) above setMaxVertices() fail the load. Files with sparse ids are
+// loaded with setRemapIds(true) instead, which numbers edge-list ids
+// densely in first-seen order and keeps the file id of each vertex
+// (getOriginalIds()). Weights are rounded to ints (0 would mean no edge,
+// so those become 1); pattern matrices and lines without a weight get 1.
+// Symmetric matrices add both directions.
+enum GraphFormat {
+    FORMAT_AUTO = 0, // Matrix Market if the first line is its banner
+    FORMAT_EDGE_LIST = 1,
+    FORMAT_MATRIX_MARKET = 2
+};
+
+// File id -> dense id for the loader's remapping: linear probing over a
+// power-of-two table kept at most half full, so memory follows the number
+// of distinct ids rather than their range
+class IdRemap {
+private:
+    int* keys;
+    int* values; // dense id, -1 for an empty slot
+    int bits;    // log2 of the table size
+    int count;
+
+    IdRemap(const IdRemap&);
+    IdRemap& operator=(const IdRemap&);
+
+    int slotFor(int key) const {
+        return (int)(((uint32_t)key * 2654435769u) >> (32 - bits));
+    }
+
+    void place(int key, int value) {
+        int mask = (1 << bits) - 1;
+        int i = slotFor(key);
+        while (values[i] != -1) i = (i + 1) & mask;
+        keys[i] = key;
+        values[i] = value;
+    }
+
+    void grow() {
+        int oldSize = (bits == 0) ? 0 : 1 << bits;
+        int* oldKeys = keys;
+        int* oldValues = values;
+        bits = (bits == 0) ? 10 : bits + 1;
+        keys = new int[1 << bits];
+        values = new int[1 << bits];
+        for (int i = 0; i < (1 << bits); i++) values[i] = -1;
+        for (int i = 0; i < oldSize; i++) {
+            if (oldValues[i] != -1) place(oldKeys[i], oldValues[i]);
+        }
+        delete[] oldKeys;
+        delete[] oldValues;
+    }
+
+public:
+    IdRemap() : keys(NULL), values(NULL), bits(0), count(0) {}
+
+    ~IdRemap() {
+        delete[] keys;
+        delete[] values;
+    }
+
+    // Dense id of key; a key not seen before gets next
+    int lookup(int key, int next) {
+        if (bits == 0 || (count + 1) * 2 > (1 << bits)) grow();
+        int mask = (1 << bits) - 1;
+        int i = slotFor(key);
+        while (values[i] != -1) {
+            if (keys[i] == key) return values[i];
+            i = (i + 1) & mask;
+        }
+        keys[i] = key;
+        values[i] = next;
+        count++;
+        return next;
+    }
+
+    int size() const {
+        return count;
+    }
+
+    size_t heapBytes() const {
+        return (bits == 0) ? 0 : ((size_t)1 << bits) * 2 * sizeof(int);
+    }
+};
+
+class GraphLoader {
+private:
+    static const int MAX_LINE = 1 << 16;
+    // Ceiling for setMaxVertices(); the default keeps a bad id from
+    // growing the graph past about 128 MB
+    static const int MAX_VERTICES = 1 << 27;
+    static const int DEFAULT_MAX_VERTICES = 1 << 24;
+
+    enum Stage { STAGE_FIRST_LINE, STAGE_SIZE_LINE, STAGE_ENTRIES };
+
+    Graph& graph;
+    int format;
+    int stage;
+    bool symmetric; // Matrix Market: mirror every entry
+    bool pattern;   // Matrix Market: no value column
+    int declared;   // Matrix Market: vertex count from the size line
+    char* carry;    // partial line left over from the last chunk
+    int carrySize;
+    int carryCap;
+    double bytesRead;
+    int lineNumber;
+    int edgesLoaded;
+    int expectedEdges; // -1 when the format does not say
+    int maxVertices;
+    bool remap;          // edge lists: number ids densely (see IdRemap)
+    IdRemap remapped;
+    IntBuffer originalIds; // file id of each remapped vertex
+    bool failed;
+    string error;
+
+    GraphLoader(const GraphLoader&);
+    GraphLoader& operator=(const GraphLoader&);
+
+    void fail(const char* message) {
+        if (failed) return;
+        failed = true;
+        error = "line " + intToString(lineNumber) + ": " + message;
+    }
+
+    void keep(const char* begin, const char* end) {
+        int length = (int)(end - begin);
+        if (carrySize + length > MAX_LINE) {
+            lineNumber++;
+            fail("line too long");
+            return;
+        }
+        if (carrySize + length > carryCap) {
+            int newCap = (carryCap == 0) ? 256 : carryCap;
+            while (newCap < carrySize + length) newCap *= 2;
+            char* grown = new char[newCap];
+            if (carrySize > 0) memcpy(grown, carry, carrySize);
+            delete[] carry;
+            carry = grown;
+            carryCap = newCap;
+        }
+        memcpy(carry + carrySize, begin, length);
+        carrySize += length;
+    }
+
+    static bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == ',' || c == '\r';
+    }
+
+    static void skipSpaces(const char*& p, const char* end) {
+        while (p < end && isSpace(*p)) p++;
+    }
+
+    // Decimal integer; false if the next field is not one
+    static bool readInt(const char*& p, const char* end, long long& out) {
+        skipSpaces(p, end);
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+        if (p == end || *p < '0' || *p > '9') return false;
+        long long value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (value < 1000000000000LL) value = value * 10 + (*p - '0');
+            p++;
+        }
+        if (p < end && !isSpace(*p)) return false;
+        out = negative ? -value : value;
+        return true;
+    }
+
+    // Decimal number with optional fraction and exponent
+    static bool readNumber(const char*& p, const char* end, double& out) {
+        skipSpaces(p, end);
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+        double value = 0;
+        bool digits = false;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value = value * 10 + (*p++ - '0');
+            digits = true;
+        }
+        if (p < end && *p == '.') {
+            p++;
+            double scale = 0.1;
+            while (p < end && *p >= '0' && *p <= '9') {
+                value += (*p++ - '0') * scale;
+                scale *= 0.1;
+                digits = true;
+            }
+        }
+        if (!digits) return false;
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            long long exponent;
+            if (!readInt(p, end, exponent)) return false;
+            value *= pow(10.0, (double)(exponent > 400 ? 400 : (exponent < -400 ? -400 : exponent)));
+        }
+        if (p < end && !isSpace(*p)) return false;
+        out = negative ? -value : value;
+        return true;
+    }
+
+    // Lower-cased next word of a banner line
+    static string readWord(const char*& p, const char* end) {
+        skipSpaces(p, end);
+        string word;
+        while (p < end && !isSpace(*p)) {
+            char c = *p++;
+            word += (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+        }
+        return word;
+    }
+
+    // "%%MatrixMarket", in any case
+    static bool isBanner(const char* p, const char* end) {
+        static const char BANNER[] = "%%matrixmarket";
+        if (end - p < 14) return false;
+        for (int i = 0; i < 14; i++) {
+            char c = p[i];
+            if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+            if (c != BANNER[i]) return false;
+        }
+        return true;
+    }
+
+    static int toWeight(double value) {
+        if (value > 2147483647.0) return 2147483647;
+        if (value < -2147483647.0) return -2147483647;
+        int w = (int)(value < 0 ? value - 0.5 : value + 0.5);
+        return (w == 0) ? 1 : w;
+    }
+
+    void ensureVertices(long long count) {
+        while (graph.n < count) graph.addVertex();
+    }
+
+    int denseId(int fileId) {
+        int id = remapped.lookup(fileId, originalIds.size);
+        if (id == originalIds.size) {
+            if (id >= maxVertices) {
+                fail("too many distinct vertex ids (see setMaxVertices)");
+                return 0;
+            }
+            originalIds.push(fileId);
+        }
+        return id;
+    }
+
+    // "%%MatrixMarket matrix coordinate <field> <symmetry>"
+    void readBanner(const char* p, const char* end) {
+        p += 14;
+        string object = readWord(p, end);
+        string layout = readWord(p, end);
+        string field = readWord(p, end);
+        string symmetry = readWord(p, end);
+        if (object != "matrix" || layout != "coordinate") {
+            fail("only coordinate matrices are supported");
+            return;
+        }
+        if (field != "real" && field != "integer" && field != "double" && field != "pattern") {
+            fail("unsupported Matrix Market field");
+            return;
+        }
+        if (symmetry != "general" && symmetry != "symmetric") {
+            fail("unsupported Matrix Market symmetry");
+            return;
+        }
+        pattern = (field == "pattern");
+        symmetric = (symmetry == "symmetric");
+        format = FORMAT_MATRIX_MARKET;
+        stage = STAGE_SIZE_LINE;
+    }
+
+    void readSizeLine(const char* p, const char* end) {
+        long long rows, cols, entries;
+        if (!readInt(p, end, rows) || !readInt(p, end, cols) || !readInt(p, end, entries) ||
+            rows < 0 || cols < 0 || entries < 0) {
+            fail("expected \"rows cols entries\"");
+            return;
+        }
+        long long vertices = (rows > cols) ? rows : cols;
+        if (vertices > maxVertices || entries > 2147483647LL) {
+            fail("matrix too large (see setMaxVertices)");
+            return;
+        }
+        declared = (int)vertices;
+        expectedEdges = (int)entries;
+        ensureVertices(declared);
+        stage = STAGE_ENTRIES;
+    }
+
+    void readEntry(const char* p, const char* end) {
+        long long u, v;
+        if (!readInt(p, end, u) || !readInt(p, end, v)) {
+            fail("expected two vertex ids");
+            return;
+        }
+        int w = 1;
+        bool market = (format == FORMAT_MATRIX_MARKET);
+        if (!market || !pattern) {
+            double value;
+            const char* field = p;
+            skipSpaces(field, end);
+            if (field < end) {
+                if (!readNumber(p, end, value)) {
+                    fail("bad weight");
+                    return;
+                }
+                w = toWeight(value);
+            }
+            else if (market) {
+                fail("missing value");
+                return;
+            }
+        }
+
+        if (market) {
+            if (u < 1 || v < 1 || u > declared || v > declared) {
+                fail("index outside the declared size");
+                return;
+            }
+            u--;
+            v--;
+        }
+        else {
+            if (u < 0 || v < 0) {
+                fail("negative vertex id");
+                return;
+            }
+            if (remap) {
+                if (u > 2147483647LL || v > 2147483647LL) {
+                    fail("vertex id too large");
+                    return;
+                }
+                u = denseId((int)u);
+                v = denseId((int)v);
+                if (failed) return;
+            }
+            else if (u >= maxVertices || v >= maxVertices) {
+                fail("vertex id too large (see setMaxVertices and setRemapIds)");
+                return;
+            }
+            ensureVertices((u > v ? u : v) + 1);
+        }
+
+        graph.addEdge((int)u, (int)v, w);
+        if (symmetric && u != v) graph.addEdge((int)v, (int)u, w);
+        edgesLoaded++;
+    }
+
+    // SNAP headers announce "# Nodes: N Edges: M"; M drives progress
+    void readEdgeCountComment(const char* p, const char* end) {
+        for (; end - p > 6; p++) {
+            if (memcmp(p, "Edges:", 6) != 0) continue;
+            p += 6;
+            long long count;
+            if (readInt(p, end, count) && count >= 0 && count <= 2147483647LL) {
+                expectedEdges = (int)count;
+            }
+            return;
+        }
+    }
+
+    void readLine(const char* begin, const char* end) {
+        lineNumber++;
+        if (end > begin && end[-1] == '\r') end--;
+        const char* p = begin;
+        skipSpaces(p, end);
+
+        if (stage == STAGE_FIRST_LINE) {
+            bool banner = isBanner(p, end);
+            if (banner && format != FORMAT_EDGE_LIST) {
+                readBanner(p, end);
+                return;
+            }
+            if (format == FORMAT_MATRIX_MARKET) {
+                fail("missing %%MatrixMarket banner");
+                return;
+            }
+            format = FORMAT_EDGE_LIST;
+            stage = STAGE_ENTRIES;
+        }
+
+        if (p == end || *p == '#' || *p == '%') {
+            if (format == FORMAT_EDGE_LIST) readEdgeCountComment(p, end);
+            return;
+        }
+        if (stage == STAGE_SIZE_LINE) readSizeLine(p, end);
+        else readEntry(p, end);
+    }
+
+public:
+    // Loads into graph, which is switched to CSR storage first
+    GraphLoader(Graph& target, int inputFormat = FORMAT_AUTO)
+        : graph(target),
+        format(inputFormat == FORMAT_EDGE_LIST || inputFormat == FORMAT_MATRIX_MARKET ? inputFormat : FORMAT_AUTO),
+        stage(STAGE_FIRST_LINE), symmetric(false), pattern(false), declared(0), carry(NULL),
+        carrySize(0), carryCap(0), bytesRead(0), lineNumber(0), edgesLoaded(0), expectedEdges(-1),
+        maxVertices(DEFAULT_MAX_VERTICES), remap(false), failed(false) {
+        graph.setStorageMode(STORAGE_CSR);
+    }
+
+    ~GraphLoader() {
+        delete[] carry;
+    }
+
+    // Parses the next chunk; false (see getError()) once the input is bad
+    bool feed(const char* bytes, int length) {
+        if (failed) return false;
+        bytesRead += length;
+        const char* p = bytes;
+        const char* end = bytes + length;
+        while (p < end && !failed) {
+            const char* newline = (const char*)memchr(p, '\n', end - p);
+            if (newline == NULL) {
+                keep(p, end);
+                break;
+            }
+            if (carrySize > 0) {
+                keep(p, newline);
+                if (failed) break;
+                readLine(carry, carry + carrySize);
+                carrySize = 0;
+            }
+            else {
+                readLine(p, newline);
+            }
+            p = newline + 1;
+        }
+        return !failed;
+    }
+
+    // Parses a last line without a newline and merges the edges into the
+    // CSR arrays. False if the input was bad or a Matrix Market file ended
+    // before its declared entry count.
+    bool finish() {
+        if (!failed && carrySize > 0) {
+            readLine(carry, carry + carrySize);
+            carrySize = 0;
+        }
+        if (!failed && format == FORMAT_MATRIX_MARKET) {
+            if (stage != STAGE_ENTRIES) fail("missing size line");
+            else if (edgesLoaded != expectedEdges) fail("entry count does not match the size line");
+        }
+        graph.prepare();
+        return !failed;
+    }
+
+    // FORMAT_EDGE_LIST or FORMAT_MATRIX_MARKET once the first line is in
+    int getFormat() {
+        return format;
+    }
+
+    double getBytesRead() {
+        return bytesRead;
+    }
+
+    int getLineNumber() {
+        return lineNumber;
+    }
+
+    int getEdgesLoaded() {
+        return edgesLoaded;
+    }
+
+    // From the Matrix Market size line or a SNAP "Edges:" comment, else -1
+    int getExpectedEdges() {
+        return expectedEdges;
+    }
+
+    // Largest vertex count the load may create, up to 2^27 (2^24 by
+    // default); an id or matrix size beyond it fails the load
+    void setMaxVertices(int limit) {
+        maxVertices = (limit < 1) ? 1 : (limit > MAX_VERTICES ? MAX_VERTICES : limit);
+    }
+
+    int getMaxVertices() {
+        return maxVertices;
+    }
+
+    // Edge lists only, before the first feed(): number the file's ids 0, 1,
+    // 2, ... in order of first appearance, so memory follows the ids used
+    // rather than the largest one. Matrix Market indices are kept.
+    void setRemapIds(bool on) {
+        if (lineNumber == 0) remap = on;
+    }
+
+    bool getRemapIds() {
+        return remap;
+    }
+
+    // File id of each vertex (index = vertex id) when remapping
+    IntBuffer& getOriginalIds() {
+        return originalIds;
+    }
+
+    // Bytes owned by the loader itself: the object, the partial-line
+    // buffer and the id remapping (the graph it fills reports its own)
+    size_t memoryUsage() const {
+        return sizeof(*this) + (size_t)carryCap + remapped.heapBytes() + originalIds.heapBytes();
+    }
+
+    // Frees the partial-line buffer while no line is pending
+    void shrinkToFit() {
+        if (carrySize > 0) return;
+        delete[] carry;
+        carry = NULL;
+        carryCap = 0;
+    }
+
+    string getError() {
+        return error;
+    }
+};
+
+// ===================== FORCE LAYOUT (BARNES-HUT) =====================
+// Spring-electrical layout (Fruchterman-Reingold forces with Hu's
+// repulsion constant) of a Graph's vertices around the centre of a
+// width x height frame. Every iteration rebuilds a quadtree over the positions and takes
+// the repulsion from a far cell as one body at its centre of mass when
+// cell size / distance < theta, so an iteration is O(n log n + m) instead
+// of O(n^2). Springs pull along the edges, a weak gravity keeps loose
+// components near the centre, and the step size cools each iteration.
+// Positions are (x, y) floats per vertex id and are not clamped to the
+// frame, so large graphs can spill over it and callers fit the view to
+// their bounds. Removed ids are left out.
+// sync() picks up graph edits and keeps the positions of existing ids.
+class ForceLayout {
+private:
+    // Coincident bodies share a leaf below this depth instead of splitting
+    static const int MAX_DEPTH = 24;
+    // Vertices per parallelFor chunk of the repulsion pass
+    static const int FORCE_GRAIN = 256;
+
+    Graph& graph;
+    int n;
+    int edgeCount;
+    int* edgeFrom;
+    int* edgeTo;
+    float* positions;    // x, y per vertex id
+    float* displacement; // this iteration's dx, dy per vertex id
+    bool* pinned;        // dragged vertices the step leaves in place
+    bool* active;        // live vertex ids at the last sync()
+    int* order;          // live ids in quadtree leaf order, for locality
+    int orderCount;
+    int stackedCount;    // ids sharing a depth-limit leaf, kept at the end of order
+    int compactionsSeen; // graph.getCompactionCount() at the last sync()
+
+    // Quadtree cell, 32 bytes so a visit touches one cache line. While
+    // the tree is built massX / massY hold position sums; buildTree()
+    // turns them into the centre of mass.
+    struct Cell {
+        float x, y; // centre of the square
+        float half; // half its side
+        float massX, massY;
+        int mass;   // bodies below
+        int body;   // vertex of a leaf, EMPTY or INTERNAL
+        int first;  // first of four consecutive children
+    };
+
+    // Rebuilt every iteration; cell 0 is the root
+    Cell* cells;
+    int cellCount;
+    int cellCap;
+
+    float width;
+    float height;
+    float theta;
+    float idealLength; // 0 = sqrt(area / live vertices)
+    float repulsion;   // C in C * k^2 / d
+    float gravity;
+    float temperature; // largest move per iteration
+    float cooling;
+    float lastMovement;
+    int iterations;
+    unsigned int seed;
+
+    enum { EMPTY = -1, INTERNAL = -2 };
+
+    ForceLayout(const ForceLayout&);
+    ForceLayout& operator=(const ForceLayout&);
+
+    float nextRandom() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return (float)(seed >> 8) / 16777216.0f;
+    }
+
+    void placeRandomly(int v) {
+        positions[v * 2] = width * (0.25f + 0.5f * nextRandom());
+        positions[v * 2 + 1] = height * (0.25f + 0.5f * nextRandom());
+    }
+
+    float springLength() {
+        if (idealLength > 0.0f) return idealLength;
+        int live = graph.getLiveVertexCount();
+        return sqrtf(width * height / (float)(live > 0 ? live : 1));
+    }
+
+    // Appends four empty cells for the quadrants of parent
+    void subdivide(int parent) {
+        if (cellCount + 4 > cellCap) {
+            int newCap = cellCap > 0 ? cellCap * 2 : 256;
+            Cell* grown = new Cell[newCap];
+            for (int i = 0; i < cellCount; i++) grown[i] = cells[i];
+            delete[] cells;
+            cells = grown;
+            cellCap = newCap;
+        }
+        Cell& cell = cells[parent];
+        float half = cell.half * 0.5f;
+        cell.first = cellCount;
+        for (int q = 0; q < 4; q++) {
+            Cell& quarter = cells[cellCount++];
+            quarter.x = cell.x + ((q & 1) ? half : -half);
+            quarter.y = cell.y + ((q & 2) ? half : -half);
+            quarter.half = half;
+            quarter.massX = quarter.massY = 0.0f;
+            quarter.mass = 0;
+            quarter.body = EMPTY;
+        }
+    }
+
+    void addMass(Cell& cell, int v) {
+        cell.massX += positions[v * 2];
+        cell.massY += positions[v * 2 + 1];
+        cell.mass++;
+    }
+
+    int quadrant(const Cell& cell, int v) {
+        return (positions[v * 2] >= cell.x ? 1 : 0) + (positions[v * 2 + 1] >= cell.y ? 2 : 0);
+    }
+
+    void insert(int v) {
+        int at = 0;
+        for (int depth = 0;; depth++) {
+            if (cells[at].body == EMPTY) {
+                cells[at].body = v;
+                addMass(cells[at], v);
+                return;
+            }
+            if (cells[at].body >= 0) {
+                if (depth == MAX_DEPTH) {
+                    addMass(cells[at], v);
+                    order[n - 1 - stackedCount++] = v;
+                    return;
+                }
+                int resident = cells[at].body;
+                subdivide(at);
+                cells[at].body = INTERNAL;
+                Cell& below = cells[cells[at].first + quadrant(cells[at], resident)];
+                below.body = resident;
+                addMass(below, resident);
+            }
+            addMass(cells[at], v);
+            at = cells[at].first + quadrant(cells[at], v);
+        }
+    }
+
+    void buildTree() {
+        float minX = 0.0f, minY = 0.0f, maxX = 0.0f, maxY = 0.0f;
+        bool first = true;
+        for (int v = 0; v < n; v++) {
+            if (!active[v]) continue;
+            float x = positions[v * 2];
+            float y = positions[v * 2 + 1];
+            if (first) {
+                minX = maxX = x;
+                minY = maxY = y;
+                first = false;
+                continue;
+            }
+            if (x < minX) minX = x;
+            if (x > maxX) maxX = x;
+            if (y < minY) minY = y;
+            if (y > maxY) maxY = y;
+        }
+        float half = 0.5f * ((maxX - minX > maxY - minY) ? maxX - minX : maxY - minY);
+        if (cellCap == 0) {
+            cellCap = 256;
+            cells = new Cell[cellCap];
+        }
+        Cell& root = cells[0];
+        root.x = 0.5f * (minX + maxX);
+        root.y = 0.5f * (minY + maxY);
+        root.half = half * 1.01f + 1e-3f;
+        root.massX = root.massY = 0.0f;
+        root.mass = 0;
+        root.body = EMPTY;
+        cellCount = 1;
+        stackedCount = 0;
+        for (int v = 0; v < n; v++) {
+            if (active[v]) insert(v);
+        }
+        for (int i = 0; i < cellCount; i++) {
+            Cell& cell = cells[i];
+            if (cell.mass == 0) continue;
+            cell.massX /= (float)cell.mass;
+            cell.massY /= (float)cell.mass;
+        }
+
+        // Depth-first leaf order puts nearby bodies next to each other, so
+        // consecutive repel() calls walk mostly the same cells
+        orderCount = 0;
+        int stack[3 * MAX_DEPTH + 4];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Cell& cell = cells[stack[--top]];
+            if (cell.body >= 0) order[orderCount++] = cell.body;
+            else if (cell.body == INTERNAL) {
+                for (int q = 3; q >= 0; q--) stack[top++] = cell.first + q;
+            }
+        }
+        // Leaves fill at most n - stackedCount slots, but with every id live
+        // they end exactly where the stacked block starts, so slide it down
+        // with memmove rather than copying over ids not yet read
+        memmove(order + orderCount, order + n - stackedCount, stackedCount * sizeof(int));
+        orderCount += stackedCount;
+    }
+
+    // Repulsion on v from every other body, k2 / distance each
+    void repel(int v, float k2) {
+        float x = positions[v * 2];
+        float y = positions[v * 2 + 1];
+        float dx = 0.0f, dy = 0.0f;
+        float theta2 = theta * theta;
+        int stack[3 * MAX_DEPTH + 4];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Cell& cell = cells[stack[--top]];
+            int count = cell.mass;
+            if (cell.body == v) count--; // v itself (and any bodies on top of it)
+            if (count <= 0) continue;
+            float ox = x - cell.massX;
+            float oy = y - cell.massY;
+            float d2 = ox * ox + oy * oy;
+            if (cell.body == INTERNAL) {
+                float side = cell.half * 2.0f;
+                bool inside = fabsf(x - cell.x) <= cell.half && fabsf(y - cell.y) <= cell.half;
+                if (inside || side * side >= theta2 * d2) {
+                    for (int q = 0; q < 4; q++) stack[top++] = cell.first + q;
+                    continue;
+                }
+            }
+            if (d2 < 1e-6f) {
+                // Coincident: push apart along a direction fixed by the id
+                float angle = (float)(v % 628) * 0.01f;
+                ox = cosf(angle) * 1e-3f;
+                oy = sinf(angle) * 1e-3f;
+                d2 = 1e-6f;
+            }
+            float push = k2 * (float)count / d2;
+            dx += ox * push;
+            dy += oy * push;
+        }
+        displacement[v * 2] = dx;
+        displacement[v * 2 + 1] = dy;
+    }
+
+    float iterate() {
+        float k = springLength();
+        float k2 = k * k * repulsion;
+        buildTree();
+
+        TaskPool::shared().parallelFor(0, orderCount, FORCE_GRAIN, [&](int begin, int end, int) {
+            for (int i = begin; i < end; i++) repel(order[i], k2);
+        });
+
+        for (int e = 0; e < edgeCount; e++) {
+            int u = edgeFrom[e];
+            int v = edgeTo[e];
+            float ox = positions[v * 2] - positions[u * 2];
+            float oy = positions[v * 2 + 1] - positions[u * 2 + 1];
+            float pull = sqrtf(ox * ox + oy * oy) / k; // d^2 / k along the unit vector
+            displacement[u * 2] += ox * pull;
+            displacement[u * 2 + 1] += oy * pull;
+            displacement[v * 2] -= ox * pull;
+            displacement[v * 2 + 1] -= oy * pull;
+        }
+
+        float centerX = width * 0.5f;
+        float centerY = height * 0.5f;
+        float moved = 0.0f;
+        for (int v = 0; v < n; v++) {
+            if (!active[v] || pinned[v]) continue;
+            float* p = positions + v * 2;
+            float dx = displacement[v * 2] - gravity * (p[0] - centerX) * k;
+            float dy = displacement[v * 2 + 1] - gravity * (p[1] - centerY) * k;
+            float length = sqrtf(dx * dx + dy * dy);
+            if (length < 1e-9f) continue;
+            float scale = (length > temperature ? temperature : length) / length;
+            p[0] += dx * scale;
+            p[1] += dy * scale;
+            moved += length * scale;
+        }
+        temperature *= cooling;
+        iterations++;
+        return moved;
+    }
+
+public:
+    ForceLayout(Graph& g, float frameWidth, float frameHeight)
+        : graph(g), n(0), edgeCount(0), edgeFrom(NULL), edgeTo(NULL),
+          positions(NULL), displacement(NULL), pinned(NULL), active(NULL),
+          order(NULL), orderCount(0), stackedCount(0), compactionsSeen(g.getCompactionCount()),
+          cells(NULL), cellCount(0), cellCap(0),
+          width(frameWidth > 1.0f ? frameWidth : 1.0f),
+          height(frameHeight > 1.0f ? frameHeight : 1.0f),
+          theta(0.8f), idealLength(0.0f), repulsion(0.2f), gravity(0.01f),
+          temperature(0.0f), cooling(0.98f), lastMovement(0.0f), iterations(0), seed(2463534242u) {
+        sync();
+        reheat();
+    }
+
+    ~ForceLayout() {
+        delete[] edgeFrom;
+        delete[] edgeTo;
+        delete[] positions;
+        delete[] displacement;
+        delete[] pinned;
+        delete[] active;
+        delete[] order;
+        delete[] cells;
+    }
+
+    // Re-reads the graph's vertices and edges. Vertices that already had
+    // a position keep it, new ones start at random points near the centre.
+    // After Graph::compact() positions and pins follow the renumbering in
+    // getIdMap(); that map only covers the last compaction, so call sync()
+    // after each one (vertices behind several are placed afresh).
+    void sync() {
+        graph.prepare();
+        int newN = graph.getVertexCount();
+        int compacted = graph.getCompactionCount() - compactionsSeen;
+        compactionsSeen = graph.getCompactionCount();
+        if (newN != n || compacted > 0) {
+            float* newPositions = new float[newN * 2 + 2];
+            bool* newPinned = new bool[newN + 1];
+            int* from = new int[newN + 1]; // old id per new id, -1 if none
+            for (int v = 0; v < newN; v++) from[v] = (compacted == 0 && v < n) ? v : -1;
+            if (compacted == 1) {
+                const IntBuffer& idMap = graph.getIdMap();
+                int mapped = (idMap.size < n) ? idMap.size : n;
+                for (int old = 0; old < mapped; old++) {
+                    int v = idMap.data[old];
+                    if (v >= 0 && v < newN) from[v] = old;
+                }
+            }
+            for (int v = 0; v < newN; v++) {
+                if (from[v] != -1) {
+                    newPositions[v * 2] = positions[from[v] * 2];
+                    newPositions[v * 2 + 1] = positions[from[v] * 2 + 1];
+                    newPinned[v] = pinned[from[v]];
+                }
+                else {
+                    newPinned[v] = false;
+                }
+            }
+            delete[] positions;
+            delete[] pinned;
+            delete[] displacement;
+            delete[] active;
+            delete[] order;
+            positions = newPositions;
+            pinned = newPinned;
+            displacement = new float[newN * 2 + 2];
+            active = new bool[newN + 1];
+            order = new int[newN + 1];
+            n = newN;
+            for (int v = 0; v < n; v++) {
+                if (from[v] == -1) placeRandomly(v);
+            }
+            delete[] from;
+        }
+        for (int v = 0; v < n; v++) {
+            active[v] = graph.isAlive(v);
+            displacement[v * 2] = displacement[v * 2 + 1] = 0.0f;
+        }
+
+        // Each undirected edge once, each directed one (both directions of
+        // a pair pull twice as hard, which reads well as a mutual link)
+        int count = 0;
+        bool directed = graph.getIsDirected();
+        for (int u = 0; u < n; u++) {
+            if (!active[u]) continue;
+            graph.forEachNeighbor(u, [&](int v, int) {
+                if (v != u && active[v] && (directed || u < v)) count++;
+            });
+        }
+        delete[] edgeFrom;
+        delete[] edgeTo;
+        edgeFrom = new int[count + 1];
+        edgeTo = new int[count + 1];
+        edgeCount = 0;
+        for (int u = 0; u < n; u++) {
+            if (!active[u]) continue;
+            graph.forEachNeighbor(u, [&](int v, int) {
+                if (v != u && active[v] && (directed || u < v)) {
+                    edgeFrom[edgeCount] = u;
+                    edgeTo[edgeCount] = v;
+                    edgeCount++;
+                }
+            });
+        }
+    }
+
+    // Scatters every unpinned vertex over the middle of the frame
+    void randomize(int newSeed) {
+        seed = newSeed != 0 ? (unsigned int)newSeed : 1u;
+        for (int v = 0; v < n; v++) {
+            if (!pinned[v]) placeRandomly(v);
+        }
+        reheat();
+    }
+
+    // Flat x, y pairs for ids 0 .. n - 1 (e.g. an existing circle layout);
+    // false if there are fewer than 2n values
+    bool setPositions(const float* xy, int length) {
+        if (length < n * 2) return false;
+        for (int i = 0; i < n * 2; i++) positions[i] = xy[i];
+        return true;
+    }
+
+    void setPosition(int v, float x, float y) {
+        if (v < 0 || v >= n) return;
+        positions[v * 2] = x;
+        positions[v * 2 + 1] = y;
+    }
+
+    void setPinned(int v, bool fixed) {
+        if (v >= 0 && v < n) pinned[v] = fixed;
+    }
+
+    bool isPinned(int v) {
+        return v >= 0 && v < n && pinned[v];
+    }
+
+    void setFrame(float frameWidth, float frameHeight) {
+        width = frameWidth > 1.0f ? frameWidth : 1.0f;
+        height = frameHeight > 1.0f ? frameHeight : 1.0f;
+    }
+
+    // 0 compares every pair exactly; around 1 is faster and still smooth
+    void setTheta(float value) {
+        theta = value > 0.0f ? value : 0.0f;
+    }
+
+    float getTheta() {
+        return theta;
+    }
+
+    // Rest length of an edge; 0 or less derives it from the frame area
+    void setIdealLength(float length) {
+        idealLength = length > 0.0f ? length : 0.0f;
+    }
+
+    float getIdealLength() {
+        return springLength();
+    }
+
+    // Weight of the repulsion against the springs; lower packs tighter
+    void setRepulsion(float value) {
+        if (value > 0.0f) repulsion = value;
+    }
+
+    void setGravity(float value) {
+        gravity = value > 0.0f ? value : 0.0f;
+    }
+
+    // Per-iteration factor on the step size, in (0, 1]
+    void setCooling(float factor) {
+        if (factor > 0.0f && factor <= 1.0f) cooling = factor;
+    }
+
+    // Restores the starting step size (a tenth of the frame) so a settled
+    // layout moves again after edits or drags
+    void reheat() {
+        temperature = 0.1f * (width > height ? width : height);
+    }
+
+    float getTemperature() {
+        return temperature;
+    }
+
+    // Runs up to count iterations and returns the total distance moved in
+    // the last one; stops early once the step size has cooled below 0.01
+    float step(int count) {
+        for (int i = 0; i < count && temperature >= 0.01f; i++) {
+            lastMovement = iterate();
+        }
+        if (temperature < 0.01f) lastMovement = 0.0f;
+        return lastMovement;
+    }
+
+    bool isSettled() {
+        return temperature < 0.01f;
+    }
+
+    int getIterations() {
+        return iterations;
+    }
+
+    int getVertexCount() {
+        return n;
+    }
+
+    int getEdgeCount() {
+        return edgeCount;
+    }
+
+    // Quadtree cells of the last iteration
+    int getCellCount() {
+        return cellCount;
+    }
+
+    // Bytes owned by the layout: the object, the per-vertex and edge
+    // arrays and the quadtree cell buffer
+    size_t memoryUsage() const {
+        size_t bytes = sizeof(*this) + (size_t)cellCap * sizeof(Cell);
+        if (positions != NULL) {
+            size_t slots = (size_t)n + 1;
+            bytes += slots * (4 * sizeof(float) + 2 * sizeof(bool) + sizeof(int));
+        }
+        if (edgeFrom != NULL) bytes += ((size_t)edgeCount + 1) * 2 * sizeof(int);
+        return bytes;
+    }
+
+    // Frees the quadtree cells; the next step() allocates them again
+    void shrinkToFit() {
+        delete[] cells;
+        cells = NULL;
+        cellCap = 0;
+    }
+
+    // 2 * getVertexCount() floats, valid until the next sync()
+    const float* getPositions() {
+        return positions;
+    }
+};
+
+// ===================== 4. HASH TABLE (CHAINING / OPEN ADDRESSING) =====================
+// Hashers return 32 well-mixed bits and tables index with the top ones
+// (hash >> shift), so every table size is a power of two and no lookup
+// divides. A hasher is a type with static uint32_t hash(const Key&).
+
+// Multiply-shift (Fibonacci hashing): key * 2^32/phi, one multiply.
+// Patterned keys (multiples of 10, consecutive ids) still spread over the
+// whole table, and negative keys need no abs().
+struct IntHash {
+    static uint32_t hash(int key) {
+        return (uint32_t)key * 2654435769u;
+    }
+};
+
+// wyhash-style: 16 bytes per round folded through a 64 x 64 -> 128-bit
+// multiply, so keys of up to 16 bytes cost two multiplies
+struct StringHash {
+    static uint64_t fold(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+        __uint128_t product = (__uint128_t)a * b;
+        return (uint64_t)product ^ (uint64_t)(product >> 64);
+#else
+        uint64_t aLow = (uint32_t)a, aHigh = a >> 32;
+        uint64_t bLow = (uint32_t)b, bHigh = b >> 32;
+        uint64_t low = aLow * bLow;
+        uint64_t middle = aHigh * bLow;
+        uint64_t cross = (low >> 32) + (uint32_t)middle + aLow * bHigh;
+        uint64_t high = aHigh * bHigh + (middle >> 32) + (cross >> 32);
+        return ((cross << 32) | (uint32_t)low) ^ high;
+#endif
+    }
+
+    // Up to 8 bytes as a little-endian word
+    static uint64_t read(const char* bytes, int count) {
+        uint64_t word = 0;
+        memcpy(&word, bytes, (size_t)count);
+        return word;
+    }
+
+    static uint32_t hash(const char* bytes, int length) {
+        const uint64_t P0 = 0xa0761d6478bd642full;
+        const uint64_t P1 = 0xe7037ed1a0b428dbull;
+        const uint64_t P2 = 0x8ebc6af09c88c6e3ull;
+        uint64_t seed = P0 ^ (uint64_t)length;
+        int at = 0;
+        for (; at + 16 < length; at += 16) {
+            seed = fold(read(bytes + at, 8) ^ P1, read(bytes + at + 8, 8) ^ seed);
+        }
+        int rest = length - at;
+        uint64_t a = read(bytes + at, rest < 8 ? rest : 8);
+        uint64_t b = rest > 8 ? read(bytes + at + 8, rest - 8) : 0;
+        uint64_t h = fold(P2 ^ (uint64_t)length, fold(a ^ P1, b ^ seed));
+        return (uint32_t)(h >> 32) ^ (uint32_t)h;
+    }
+
+    static uint32_t hash(const string& key) {
+        return hash(key.data(), (int)key.size());
+    }
+};
+
+template <typename Key>
+struct DefaultHash;
+
+template <>
+struct DefaultHash<int> : IntHash {};
+
+template <>
+struct DefaultHash<string> : StringHash {};
+
+// Per-type pieces of the table: what search() returns for a missing key,
+// the int a traced probe records for a key, getTable() formatting, and
+// the heap bytes a key or value holds beyond its own size
+inline int missingValue(const int*) {
+    return -1;
+}
+
+inline string missingValue(const string*) {
+    return string();
+}
+
+inline int traceKey(int key) {
+    return key;
+}
+
+inline int traceKey(const string& key) {
+    return (int)StringHash::hash(key);
+}
+
+inline string toText(int x) {
+    return intToString(x);
+}
+
+inline string toText(const string& text) {
+    return "\"" + text + "\"";
+}
+
+inline size_t ownedBytes(int) {
+    return 0;
+}
+
+// Short strings live inside the object (small-string optimisation)
+inline size_t ownedBytes(const string& text) {
+    const char* chars = text.data();
+    bool inside = chars >= (const char*)&text && chars < (const char*)(&text + 1);
+    return inside ? 0 : text.capacity() + 1;
+}
+
+template <typename Key, typename Value>
+struct HashNode {
+    Key key;
+    Value value;
+    HashNode* next;
+
+    HashNode(const Key& k, const Value& v) : key(k), value(v), next(NULL) {}
+};
+
+enum HashMode {
+    HASH_CHAINING = 0,
+    HASH_OPEN_ADDRESSING = 1
+};
+
+// Key -> Value map in either mode. HashTable (int -> int) is the one the
+// visualizer draws and the only one with exportTable(), the batch calls
+// and snapshots; StringHashTable maps strings to ints.
+template <typename Key, typename Value, typename Hasher = DefaultHash<Key> >
+class BasicHashTable {
+private:
+    typedef HashNode<Key, Value> Chain;
+
+    // Chaining: a fixed 2^CHAIN_BITS buckets
+    static const int CHAIN_BITS = 4;
+    static const int TABLE_SIZE = 1 << CHAIN_BITS;
+    // Nodes and slots own no memory of their own (plain int tables), so
+    // clear() can drop them without running destructors
+    static const bool PLAIN = std::is_trivially_destructible<Key>::value &&
+                              std::is_trivially_destructible<Value>::value;
+
+    Chain** table;
+    NodePool<Chain> pool;
+    IntBuffer output;
+    int mode;
+    int count;
+
+    // Open addressing: linear probing over a power-of-two slot array.
+    // Deleted slots become tombstones so later probes keep walking past
+    // them; they are purged by the next rehash.
+    enum SlotState { SLOT_EMPTY = 0, SLOT_FULL = 1, SLOT_TOMBSTONE = 2 };
+    static const int OPEN_MIN_CAPACITY = 16;
+    // Largest slot count a snapshot may ask for (2^26 slots)
+    static const int OPEN_MAX_CAPACITY = 1 << 26;
+
+    Key* slotKeys;
+    Value* slotValues;
+    unsigned char* slotState;
+    int slotCap;
+    int slotShift; // 32 - log2(slotCap)
+    int tombstones;
+    float maxLoad;
+    TraceBuffer trace;
+    OpCounters counters;
+    IntBuffer snapshot;
+
+    BasicHashTable(const BasicHashTable&);
+    BasicHashTable& operator=(const BasicHashTable&);
+
+    // Exchanges the stored entries (buckets or slots, mode, load factor)
+    // with other; traces, counters and export buffers stay where they are
+    void swapContents(BasicHashTable& other) {
+        std::swap(table, other.table);
+        pool.swap(other.pool);
+        std::swap(mode, other.mode);
+        std::swap(count, other.count);
+        std::swap(slotKeys, other.slotKeys);
+        std::swap(slotValues, other.slotValues);
+        std::swap(slotState, other.slotState);
+        std::swap(slotCap, other.slotCap);
+        std::swap(slotShift, other.slotShift);
+        std::swap(tombstones, other.tombstones);
+        std::swap(maxLoad, other.maxLoad);
+    }
+
+    int hashFunction(const Key& key) {
+        return (int)(Hasher::hash(key) >> (32 - CHAIN_BITS));
+    }
+
+    int slotFor(const Key& key) {
+        return (int)(Hasher::hash(key) >> slotShift);
+    }
+
+    void allocSlots(int capacity) {
+        slotCap = capacity;
+        slotShift = 32;
+        while ((1 << (32 - slotShift)) < slotCap) slotShift--;
+        slotKeys = new Key[slotCap];
+        slotValues = new Value[slotCap];
+        slotState = new unsigned char[slotCap];
+        for (int i = 0; i < slotCap; i++) slotState[i] = SLOT_EMPTY;
+        tombstones = 0;
+    }
+
+    void freeSlots() {
+        delete[] slotKeys;
+        delete[] slotValues;
+        delete[] slotState;
+        slotKeys = NULL;
+        slotValues = NULL;
+        slotState = NULL;
+        slotCap = 0;
+    }
+
+    // Slot holding key, or -1; probes gets the number of slots examined.
+    // The load limit keeps an empty slot to stop at, but the walk is also
+    // capped at one lap of the table.
+    int findSlot(const Key& key, int& probes) {
+        int mask = slotCap - 1;
+        int i = slotFor(key);
+        probes = 1;
+        while (slotState[i] != SLOT_EMPTY) {
+            trace.record(TRACE_PROBE, i, traceKey(key), slotState[i]);
+            if (slotState[i] == SLOT_FULL && slotKeys[i] == key) return i;
+            if (probes == slotCap) return -1;
+            i = (i + 1) & mask;
+            probes++;
+        }
+        trace.record(TRACE_PROBE, i, traceKey(key), SLOT_EMPTY);
+        return -1;
+    }
+
+    void countLookup(int probes) {
+        counters.add(COUNT_LOOKUP);
+        counters.add(COUNT_PROBE, probes);
+        counters.raise(COUNT_MAX_PROBE, probes);
+    }
+
+    // Place a key known to be absent; used by rehash after tombstones are gone
+    void placeNew(const Key& key, const Value& value) {
+        int mask = slotCap - 1;
+        int i = slotFor(key);
+        while (slotState[i] == SLOT_FULL) i = (i + 1) & mask;
+        slotKeys[i] = key;
+        slotValues[i] = value;
+        slotState[i] = SLOT_FULL;
+    }
+
+    // Smallest power-of-two capacity keeping `needed` entries under maxLoad
+    int capacityFor(int needed) {
+        int capacity = OPEN_MIN_CAPACITY;
+        while ((float)needed > maxLoad * capacity) capacity *= 2;
+        return capacity;
+    }
+
+    void rehash(int capacity) {
+        int oldCap = slotCap;
+        Key* oldKeys = slotKeys;
+        Value* oldValues = slotValues;
+        unsigned char* oldState = slotState;
+
+        allocSlots(capacity);
+        for (int i = 0; i < oldCap; i++) {
+            if (oldState[i] == SLOT_FULL) placeNew(oldKeys[i], oldValues[i]);
+        }
+
+        delete[] oldKeys;
+        delete[] oldValues;
+        delete[] oldState;
+    }
+
+    void openInsert(const Key& key, const Value& value) {
+        // Full and tombstoned slots both lengthen probes, so both count
+        if ((float)(count + tombstones + 1) > maxLoad * slotCap) {
+            rehash(capacityFor(count + 1));
+        }
+
+        int mask = slotCap - 1;
+        int i = slotFor(key);
+        int firstTombstone = -1;
+        while (slotState[i] != SLOT_EMPTY) {
+            trace.record(TRACE_PROBE, i, traceKey(key), slotState[i]);
+            if (slotState[i] == SLOT_FULL && slotKeys[i] == key) {
+                slotValues[i] = value;
+                return;
+            }
+            if (slotState[i] == SLOT_TOMBSTONE && firstTombstone == -1) firstTombstone = i;
+            i = (i + 1) & mask;
+        }
+        trace.record(TRACE_PROBE, i, traceKey(key), SLOT_EMPTY);
+
+        if (firstTombstone != -1) {
+            i = firstTombstone;
+            tombstones--;
+        }
+        slotKeys[i] = key;
+        slotValues[i] = value;
+        slotState[i] = SLOT_FULL;
+        count++;
+    }
+
+    // Chain of key's bucket; records the trace probes for it
+    Chain** chainFor(const Key& key) {
+        int index = hashFunction(key);
+        trace.record(TRACE_PROBE, index, traceKey(key), -1);
+        return &table[index];
+    }
+
+    void chainInsert(const Key& key, const Value& value) {
+        Chain** head = chainFor(key);
+
+        Chain* current = *head;
+        int position = 0;
+        while (current) {
+            trace.record(TRACE_PROBE, (int)(head - table), traceKey(key), position++);
+            if (current->key == key) {
+                current->value = value;
+                return;
+            }
+            current = current->next;
+        }
+
+        Chain* newNode = pool.create(key, value);
+        newNode->next = *head;
+        *head = newNode;
+        count++;
+    }
+
+    // Calls visit(key, value) for each entry, bucket by bucket in chain
+    // order, or slot by slot
+    template <typename Visit>
+    void forEachEntry(Visit visit) {
+        if (mode == HASH_OPEN_ADDRESSING) {
+            for (int i = 0; i < slotCap; i++) {
+                if (slotState[i] == SLOT_FULL) visit(slotKeys[i], slotValues[i]);
+            }
+            return;
+        }
+        for (int b = 0; b < TABLE_SIZE; b++) {
+            for (Chain* current = table[b]; current; current = current->next) {
+                visit(current->key, current->value);
+            }
+        }
+    }
+
+public:
+    BasicHashTable(int hashMode = HASH_CHAINING)
+        : mode(hashMode == HASH_OPEN_ADDRESSING ? HASH_OPEN_ADDRESSING : HASH_CHAINING),
+        count(0), slotKeys(NULL), slotValues(NULL), slotState(NULL), slotCap(0),
+        slotShift(32), tombstones(0), maxLoad(0.75f) {
+        table = new Chain * [TABLE_SIZE];
+        for (int i = 0; i < TABLE_SIZE; i++) {
+            table[i] = NULL;
+        }
+        if (mode == HASH_OPEN_ADDRESSING) allocSlots(OPEN_MIN_CAPACITY);
+    }
+
+    ~BasicHashTable() {
+        if (!PLAIN) clear();
+        delete[] table;
+        freeSlots();
+    }
+
+    void insert(const Key& key, const Value& value) {
+        if (mode == HASH_OPEN_ADDRESSING) openInsert(key, value);
+        else chainInsert(key, value);
+    }
+
+    // Stored value for key; missing keys return -1 (int values) or an
+    // empty string
+    Value search(const Key& key) {
+        if (mode == HASH_OPEN_ADDRESSING) {
+            int probes;
+            int i = findSlot(key, probes);
+            countLookup(probes);
+            return (i == -1) ? missingValue((const Value*)NULL) : slotValues[i];
+        }
+
+        Chain** head = chainFor(key);
+
+        Chain* current = *head;
+        int position = 0;
+        while (current) {
+            trace.record(TRACE_PROBE, (int)(head - table), traceKey(key), position++);
+            if (current->key == key) {
+                countLookup(position);
+                return current->value;
+            }
+            current = current->next;
+        }
+
+        countLookup(position);
+        return missingValue((const Value*)NULL);
+    }
+
+    // Flat (key, value) pairs (int tables). Open addressing sizes the
+    // table for the whole batch up front instead of rehashing several times.
+    void putMany(const int* pairs, int length) {
+        if (mode == HASH_OPEN_ADDRESSING) {
+            int needed = count + length / 2;
+            if ((float)(needed + tombstones) > maxLoad * slotCap) rehash(capacityFor(needed));
+        }
+        for (int i = 0; i + 1 < length; i += 2) {
+            insert(pairs[i], pairs[i + 1]);
+        }
+    }
+
+    // Value for each key (-1 when missing), in key order
+    IntBuffer& searchMany(const int* keys, int length) {
+        output.clear();
+        output.reserve(length);
+        for (int i = 0; i < length; i++) {
+            output.push(search(keys[i]));
+        }
+        return output;
+    }
+
+    bool remove(const Key& key) {
+        if (mode == HASH_OPEN_ADDRESSING) {
+            int probes;
+            int i = findSlot(key, probes);
+            if (i == -1) return false;
+            if (!PLAIN) {
+                slotKeys[i] = Key();
+                slotValues[i] = Value();
+            }
+            slotState[i] = SLOT_TOMBSTONE;
+            tombstones++;
+            count--;
+            return true;
+        }
+
+        Chain** head = chainFor(key);
+        Chain** link = head;
+        int position = 0;
+        while (*link) {
+            trace.record(TRACE_PROBE, (int)(head - table), traceKey(key), position++);
+            if ((*link)->key == key) {
+                Chain* dead = *link;
+                *link = dead->next;
+                pool.destroy(dead);
+                count--;
+                return true;
+            }
+            link = &(*link)->next;
+        }
+        return false;
+    }
+
+    int getMode() {
+        return mode;
+    }
+
+    // Moves every entry into the other representation
+    void setMode(int newMode) {
+        newMode = (newMode == HASH_OPEN_ADDRESSING) ? HASH_OPEN_ADDRESSING : HASH_CHAINING;
+        if (newMode == mode) return;
+
+        int entries = count;
+        Key* keys = new Key[entries > 0 ? entries : 1];
+        Value* values = new Value[entries > 0 ? entries : 1];
+        int at = 0;
+        forEachEntry([&](const Key& key, const Value& value) {
+            keys[at] = key;
+            values[at] = value;
+            at++;
+        });
+
+        clear();
+        mode = newMode;
+        freeSlots();
+        if (mode == HASH_OPEN_ADDRESSING) allocSlots(capacityFor(entries));
+        for (int i = 0; i < entries; i++) insert(keys[i], values[i]);
+        delete[] keys;
+        delete[] values;
+    }
+
+    // Open addressing grows once (entries + tombstones) exceed
+    // factor * capacity; clamped to [0.1, 0.95]
+    void setMaxLoadFactor(float factor) {
+        if (factor < 0.1f) factor = 0.1f;
+        if (factor > 0.95f) factor = 0.95f;
+        maxLoad = factor;
+        if (mode == HASH_OPEN_ADDRESSING && (float)(count + tombstones) > maxLoad * slotCap) {
+            rehash(capacityFor(count));
+        }
+    }
+
+    float getMaxLoadFactor() {
+        return maxLoad;
+    }
+
+    int getSize() {
+        return count;
+    }
+
+    // Bucket count (chaining) or slot count (open addressing)
+    int getCapacity() {
+        return (mode == HASH_OPEN_ADDRESSING) ? slotCap : TABLE_SIZE;
+    }
+
+    // Flat layout (int tables): bucket count, then per bucket its length
+    // followed by that many key, value pairs in chain order. Open
+    // addressing reports each slot as a bucket of length 0 or 1.
+    IntBuffer& exportTable() {
+        output.clear();
+        if (mode == HASH_OPEN_ADDRESSING) {
+            output.reserve(1 + slotCap + 2 * count);
+            output.push(slotCap);
+            for (int i = 0; i < slotCap; i++) {
+                if (slotState[i] == SLOT_FULL) {
+                    output.push(1);
+                    output.push(slotKeys[i]);
+                    output.push(slotValues[i]);
+                }
+                else {
+                    output.push(0);
+                }
+            }
+            return output;
+        }
+
+        output.push(TABLE_SIZE);
+        for (int i = 0; i < TABLE_SIZE; i++) {
+            int lengthAt = output.size;
+            output.push(0);
+            for (Chain* current = table[i]; current; current = current->next) {
+                output.push(current->key);
+                output.push(current->value);
+                output.data[lengthAt]++;
+            }
+        }
+        return output;
+    }
+
+    // Snapshot (see SNAPSHOTS, int tables) payload: mode, max load factor,
+    // count, then
+    //   open addressing: slot count, tombstone count, the tombstoned slots
+    //   (probes must still walk past them), and a (slot, key, value)
+    //   triple per entry
+    //   chaining: (key, value) pairs bucket by bucket, each chain from its
+    //   tail, so re-inserting them (new nodes go first) rebuilds the chains
+    IntBuffer& serialize() {
+        SnapshotWriter out(snapshot, SNAPSHOT_HASH);
+        out.put(mode);
+        out.putFloat(maxLoad);
+        out.put(count);
+        if (mode == HASH_OPEN_ADDRESSING) {
+            out.put(slotCap);
+            out.put(tombstones);
+            for (int i = 0; i < slotCap; i++) {
+                if (slotState[i] == SLOT_TOMBSTONE) out.put(i);
+            }
+            for (int i = 0; i < slotCap; i++) {
+                if (slotState[i] != SLOT_FULL) continue;
+                out.put(i);
+                out.put(slotKeys[i]);
+                out.put(slotValues[i]);
+            }
+            return out.finish();
+        }
+
+        for (int b = 0; b < TABLE_SIZE; b++) {
+            int first = snapshot.size;
+            for (Chain* current = table[b]; current; current = current->next) {
+                out.put(current->key);
+                out.put(current->value);
+            }
+            // Reverse the chain's pairs in place
+            for (int i = first, j = snapshot.size - 2; i < j; i += 2, j -= 2) {
+                int key = snapshot.data[i];
+                int value = snapshot.data[i + 1];
+                snapshot.data[i] = snapshot.data[j];
+                snapshot.data[i + 1] = snapshot.data[j + 1];
+                snapshot.data[j] = key;
+                snapshot.data[j + 1] = value;
+            }
+        }
+        return out.finish();
+    }
+
+    // Restores a serialize() result with every entry and tombstone in its
+    // old slot or chain position. The entries go into a scratch table that
+    // is swapped in once it checks out, so a rejected snapshot leaves this
+    // one as it was.
+    bool deserialize(const int* words, int length) {
+        SnapshotReader in(words, length, SNAPSHOT_HASH);
+        int newMode = in.get();
+        float load = in.getFloat();
+        int entries = in.getCount(in.remaining());
+        bool open = (newMode == HASH_OPEN_ADDRESSING);
+        int capacity = open ? in.get() : 0;
+        int graves = open ? in.getCount(in.remaining()) : 0;
+        int width = open ? 3 : 2;
+        if (!in.valid() || (newMode != HASH_CHAINING && !open) ||
+            (long long)entries * width + graves != in.remaining())
+            return false;
+        load = (load >= 0.1f && load <= 0.95f) ? load : 0.75f;
+        // A live table never holds more than load * capacity entries and
+        // tombstones, so probes always find an empty slot
+        if (open && (capacity < OPEN_MIN_CAPACITY || capacity > OPEN_MAX_CAPACITY ||
+            (capacity & (capacity - 1)) != 0 ||
+            (float)((long long)entries + graves) > load * capacity))
+            return false;
+
+        BasicHashTable staged(HASH_CHAINING);
+        staged.mode = newMode;
+        staged.maxLoad = load;
+
+        bool ok = true;
+        if (newMode == HASH_CHAINING) {
+            for (int i = 0; i < entries; i++) {
+                int key = in.get();
+                staged.chainInsert(key, in.get());
+            }
+            ok = (staged.count == entries);
+        }
+        else {
+            staged.allocSlots(capacity);
+            for (int i = 0; i < graves && ok; i++) {
+                int slot = in.get();
+                if (slot < 0 || slot >= capacity || staged.slotState[slot] != SLOT_EMPTY) ok = false;
+                else staged.slotState[slot] = SLOT_TOMBSTONE;
+            }
+            staged.tombstones = graves;
+            for (int i = 0; i < entries && ok; i++) {
+                int slot = in.get();
+                int key = in.get();
+                int value = in.get();
+                if (slot < 0 || slot >= capacity || staged.slotState[slot] != SLOT_EMPTY) {
+                    ok = false;
+                    break;
+                }
+                staged.slotKeys[slot] = key;
+                staged.slotValues[slot] = value;
+                staged.slotState[slot] = SLOT_FULL;
+                staged.count++;
+            }
+            // Every key must be reachable along its probe sequence
+            for (int i = 0; i < capacity && ok; i++) {
+                int probes;
+                if (staged.slotState[i] == SLOT_FULL && staged.findSlot(staged.slotKeys[i], probes) != i)
+                    ok = false;
+            }
+        }
+
+        if (!ok)
+            return false;
+        swapContents(staged);
+        return true;
+    }
+
+    // Buckets (or slots) as "[[key:value,...],...]", same order as
+    // exportTable()
+    string getTable() {
+        string result = "[";
+        int buckets = getCapacity();
+        for (int i = 0; i < buckets; i++) {
+            result += "[";
+            if (mode == HASH_OPEN_ADDRESSING) {
+                if (slotState[i] == SLOT_FULL) {
+                    result += toText(slotKeys[i]) + ":" + toText(slotValues[i]);
+                }
+            }
+            else {
+                for (Chain* current = table[i]; current; current = current->next) {
+                    if (current != table[i]) result += ",";
+                    result += toText(current->key) + ":" + toText(current->value);
+                }
+            }
+            result += "]";
+            if (i < buckets - 1) result += ",";
+        }
+
+        result += "]";
+        return result;
+    }
+
+    // Bytes owned by the table: the object, the bucket array, every pool
+    // chunk, the slot arrays, string contents and the export buffers
+    size_t memoryUsage() const {
+        size_t bytes = sizeof(*this) + TABLE_SIZE * sizeof(Chain*) + pool.heapBytes() +
+            (size_t)slotCap * (sizeof(Key) + sizeof(Value) + 1) +
+            output.heapBytes() + trace.heapBytes() + counters.heapBytes() +
+            snapshot.heapBytes();
+        if (!PLAIN) {
+            for (int b = 0; b < TABLE_SIZE; b++) {
+                for (Chain* current = table[b]; current; current = current->next) {
+                    bytes += ownedBytes(current->key) + ownedBytes(current->value);
+                }
+            }
+            for (int i = 0; i < slotCap; i++) {
+                bytes += ownedBytes(slotKeys[i]) + ownedBytes(slotValues[i]);
+            }
+        }
+        return bytes;
+    }
+
+    // Releases slack after large deletions. Open addressing rehashes into
+    // the smallest capacity for the entries left, purging tombstones;
+    // chaining copies the chains, in order, into a pool sized for them.
+    // Export, trace and counter buffers are freed too.
+    void shrinkToFit() {
+        if (mode == HASH_OPEN_ADDRESSING) {
+            rehash(capacityFor(count));
+            pool.trim(); // chain nodes left from chaining mode
+        }
+        else {
+            NodePool<Chain> old;
+            old.swap(pool);
+            for (int b = 0; b < TABLE_SIZE; b++) {
+                Chain** tail = &table[b];
+                Chain* current = table[b];
+                while (current) {
+                    Chain* next = current->next;
+                    Chain* copy = pool.create(current->key, current->value);
+                    if (!PLAIN) old.destroy(current);
+                    *tail = copy;
+                    tail = &copy->next;
+                    current = next;
+                }
+                *tail = NULL;
+            }
+        }
+        output.release();
+        trace.shrink();
+        counters.shrink();
+        snapshot.release();
+    }
+
+    // Chains of plain nodes are dropped wholesale and the pool keeps
+    // their memory for reuse; string nodes are destroyed one by one
+    void clear() {
+        for (int i = 0; i < TABLE_SIZE; i++) {
+            if (!PLAIN) {
+                while (table[i]) {
+                    Chain* dead = table[i];
+                    table[i] = dead->next;
+                    pool.destroy(dead);
+                }
+            }
+            table[i] = NULL;
+        }
+        pool.reset();
+        if (mode == HASH_OPEN_ADDRESSING) {
+            for (int i = 0; i < slotCap; i++) {
+                if (!PLAIN && slotState[i] == SLOT_FULL) {
+                    slotKeys[i] = Key();
+                    slotValues[i] = Value();
+                }
+                slotState[i] = SLOT_EMPTY;
+            }
+            tombstones = 0;
+        }
+        count = 0;
+    }
+
+    // Step tracing (see TRACE BUFFER); capacity in events, 0 turns it off
+    void enableTrace(int capacity) {
+        trace.enable(capacity);
+    }
+
+    void disableTrace() {
+        trace.disable();
+    }
+
+    void clearTrace() {
+        trace.clear();
+    }
+
+    int getTraceDropped() {
+        return trace.getDropped();
+    }
+
+    IntBuffer& exportTrace() {
+        return trace.exportEvents();
+    }
+
+    // Work totals (see OP COUNTERS)
+    void resetCounters() {
+        counters.reset();
+    }
+
+    IntBuffer& exportCounters() {
+        return counters.exportValues();
+    }
+};
+
+typedef BasicHashTable<int, int> HashTable;
+typedef BasicHashTable<string, int> StringHashTable;
+
+#endif // DATA_H
@@ -0,0 +1,109 @@
+/* ==================== WASM ENGINE WORKER ==================== */
+// Runs the data.cpp structures (data.js / data.wasm) off the main thread.
+// The page posts batches of commands; each batch gets a single reply, and
+// typed-array results come back as transferred buffers, not copies.
+//
+// Batch:   { seq, commands: [command, ...] }
+//   { op: "create", handle, type, args }   new Module[type](...args)
+//   { op: "call", handle, method, args }   instance[method](...args)
+//                                          (handle null calls Module[method])
+//   { op: "destroy", handle }              instance.delete()
+// Reply:   { seq, results } or { seq, results, error }
+// A failing command stops the batch: results holds everything before it.
+// An argument of the form { handle } stands for that instance, so objects
+// can be passed to constructors and methods (e.g. new GraphLoader(graph)).
+//
+// The data.js / data.wasm checked in predate this engine: they only export
+// LinkedList, so creating a Graph, AVLTree, GraphLoader or ForceLayout fails
+// until they are rebuilt from data.cpp (see "Building the C++ engine" in
+// README.md).
+
+const instances = new Map();
+const backlog = []; // batches that arrived before the runtime was ready
+let ready = false;
+let nextReturnedHandle = -1; // objects returned by C++ get negative handles
+
+self.Module = {
+  onRuntimeInitialized() {
+    ready = true;
+    backlog.splice(0).forEach(runBatch);
+  },
+};
+importScripts("data.js");
+
+// Views into wasm memory only stay valid until the next call, so copy
+// them once into their own buffer and hand that buffer over.
+function toTransferable(value, transfer) {
+  if (ArrayBuffer.isView(value)) {
+    const copy = value.slice();
+    transfer.push(copy.buffer);
+    return copy;
+  }
+  if (value && typeof value === "object" && typeof value.delete === "function") {
+    const handle = nextReturnedHandle--;
+    instances.set(handle, value);
+    return { handle };
+  }
+  return value;
+}
+
+function lookup(handle) {
+  const instance = instances.get(handle);
+  if (!instance) throw new Error(`Unknown handle ${handle}`);
+  return instance;
+}
+
+function resolveArg(arg) {
+  if (arg && typeof arg === "object" && !ArrayBuffer.isView(arg)) {
+    const keys = Object.keys(arg);
+    if (keys.length === 1 && keys[0] === "handle") return lookup(arg.handle);
+  }
+  return arg;
+}
+
+function runCommand(command) {
+  const args = (command.args || []).map(resolveArg);
+  switch (command.op) {
+    case "create": {
+      const Type = Module[command.type];
+      if (typeof Type !== "function") {
+        throw new Error(`Unknown type ${command.type} (rebuild data.js / data.wasm from data.cpp)`);
+      }
+      instances.set(command.handle, new Type(...args));
+      return command.handle;
+    }
+    case "call": {
+      const target = command.handle == null ? Module : lookup(command.handle);
+      if (typeof target[command.method] !== "function") {
+        throw new Error(`Unknown method ${command.method}`);
+      }
+      return target[command.method](...args);
+    }
+    case "destroy": {
+      lookup(command.handle).delete();
+      instances.delete(command.handle);
+      return true;
+    }
+    default:
+      throw new Error(`Unknown op ${command.op}`);
+  }
+}
+
+function runBatch(batch) {
+  const results = [];
+  const transfer = [];
+  try {
+    for (const command of batch.commands) {
+      results.push(toTransferable(runCommand(command), transfer));
+    }
+    self.postMessage({ seq: batch.seq, results }, transfer);
+  } catch (err) {
+    const error = err && err.message ? err.message : String(err);
+    self.postMessage({ seq: batch.seq, results, error }, transfer);
+  }
+}
+
+self.onmessage = (event) => {
+  if (ready) runBatch(event.data);
+  else backlog.push(event.data);
+};
@@ -0,0 +1,739 @@
+// Native tests for data.h, built by CMake as dsv_tests and run by ctest:
+//
+//   dsv_tests [--seed S]
+//
+// Randomized runs check each structure against a plain reference (std::set,
+// std::map, a sorted multiset, an O(n^2) Dijkstra) after every operation or
+// batch. The rejection tests feed deserialize() and GraphLoader damaged or
+// hostile input and expect false, an error, and no runaway allocation.
+#include "data.h"
+#include <algorithm>
+#include <limits.h>
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// ===================== HARNESS =====================
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(cond)                                                      \
+    do {                                                                 \
+        checks++;                                                        \
+        if (!(cond)) {                                                   \
+            failures++;                                                  \
+            if (failures <= 20) printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        }                                                                \
+    } while (0)
+
+// xorshift32, as in bench.cpp
+class Random {
+private:
+    unsigned int state;
+
+public:
+    Random(unsigned int seed) : state(seed ? seed : 1) {}
+
+    unsigned int next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    int below(int bound) {
+        return (int)(next() % (unsigned int)bound);
+    }
+};
+
+static unsigned int seed = 12345;
+
+// Copies out a result buffer, which the next call on its owner reuses
+vector<int> copyOf(const IntBuffer& buf) {
+    return vector<int>(buf.data, buf.data + buf.size);
+}
+
+// Keys of an exportTree() layout, checking heights and the AVL balance on
+// the way; false if any record is inconsistent
+bool treeKeys(const IntBuffer& records, vector<int>& keys) {
+    keys.clear();
+    int count = records.size / 4;
+    for (int r = 0; r < count; r++) {
+        const int* rec = records.data + r * 4;
+        int lh = (rec[2] == -1) ? 0 : records.data[rec[2] * 4 + 1];
+        int rh = (rec[3] == -1) ? 0 : records.data[rec[3] * 4 + 1];
+        if (rec[1] != 1 + (lh > rh ? lh : rh) || lh - rh > 1 || rh - lh > 1) return false;
+    }
+    // Inorder walk from record 0
+    int stack[128];
+    int sp = 0;
+    int cur = count > 0 ? 0 : -1;
+    while (cur != -1 || sp > 0) {
+        while (cur != -1) {
+            if (sp == 128) return false;
+            stack[sp++] = cur;
+            cur = records.data[cur * 4 + 2];
+        }
+        cur = stack[--sp];
+        keys.push_back(records.data[cur * 4]);
+        cur = records.data[cur * 4 + 3];
+    }
+    return (int)keys.size() == count;
+}
+
+// ===================== DIFFERENTIAL: AVL =====================
+void testAvl() {
+    Random rng(seed);
+    AVLTree tree;
+    set<int> ref;
+    for (int step = 0; step < 20000; step++) {
+        int key = rng.below(2000) - 1000;
+        if (rng.below(3) == 0) {
+            tree.remove(key);
+            ref.erase(key);
+        }
+        else {
+            tree.insert(key);
+            ref.insert(key);
+        }
+        CHECK(tree.getSize() == (int)ref.size());
+        if (step % 97 != 0) continue;
+
+        int probe = rng.below(2400) - 1200;
+        CHECK(tree.contains(probe) == (ref.count(probe) == 1));
+        CHECK(tree.rank(probe) == (int)distance(ref.begin(), ref.lower_bound(probe)));
+        int i = ref.empty() ? 0 : rng.below((int)ref.size());
+        set<int>::iterator at = ref.begin();
+        advance(at, i);
+        CHECK(tree.select(i) == (ref.empty() ? -999999 : *at));
+        int lo = probe;
+        int hi = probe + rng.below(500);
+        CHECK(tree.rangeCount(lo, hi) ==
+              (int)distance(ref.lower_bound(lo), ref.upper_bound(hi)));
+    }
+    CHECK(copyOf(tree.inorder()) == vector<int>(ref.begin(), ref.end()));
+    vector<int> keys;
+    CHECK(treeKeys(tree.exportTree(), keys) && keys == vector<int>(ref.begin(), ref.end()));
+
+    // Bulk paths and merge
+    AVLTree other;
+    set<int> otherRef;
+    vector<int> batch;
+    for (int i = 0; i < 3000; i++) batch.push_back(rng.below(5000));
+    other.insertMany(batch.data(), (int)batch.size());
+    otherRef.insert(batch.begin(), batch.end());
+    tree.mergeFrom(other);
+    ref.insert(otherRef.begin(), otherRef.end());
+    CHECK(other.getSize() == 0);
+    CHECK(copyOf(tree.inorder()) == vector<int>(ref.begin(), ref.end()));
+    CHECK(treeKeys(tree.exportTree(), keys) && keys == vector<int>(ref.begin(), ref.end()));
+
+    tree.removeMany(batch.data(), 1500);
+    for (int i = 0; i < 1500; i++) ref.erase(batch[i]);
+    CHECK(copyOf(tree.inorder()) == vector<int>(ref.begin(), ref.end()));
+
+    vector<int> sorted(ref.begin(), ref.end());
+    AVLTree built;
+    CHECK(built.buildFromSorted(sorted.data(), (int)sorted.size()));
+    CHECK(treeKeys(built.exportTree(), keys) && keys == sorted);
+
+    // Snapshot round trip keeps the exact shape
+    vector<int> saved = copyOf(tree.serialize());
+    AVLTree restored;
+    CHECK(restored.deserialize(saved.data(), (int)saved.size()));
+    CHECK(copyOf(restored.exportTree()) == copyOf(tree.exportTree()));
+}
+
+// ===================== DIFFERENTIAL: HASH TABLES =====================
+template <typename Table, typename Key>
+void checkTable(Table& table, const map<Key, int>& ref, const Key& missing) {
+    CHECK(table.getSize() == (int)ref.size());
+    for (typename map<Key, int>::const_iterator it = ref.begin(); it != ref.end(); ++it) {
+        if (table.search(it->first) != it->second) {
+            CHECK(table.search(it->first) == it->second);
+            return;
+        }
+    }
+    CHECK(table.search(missing) == missingValue((const int*)NULL));
+}
+
+void testHashTable(int mode) {
+    Random rng(seed + mode);
+    HashTable table(mode);
+    map<int, int> ref;
+    for (int step = 0; step < 20000; step++) {
+        // Patterned keys (multiples of 16) and INT_MIN as well as random
+        int key = (rng.below(4) == 0) ? (rng.below(500) * 16) : (int)rng.next();
+        if (step % 1000 == 0) key = INT_MIN;
+        int op = rng.below(4);
+        if (op == 0 && !ref.empty()) {
+            map<int, int>::iterator it = ref.lower_bound(key);
+            if (it == ref.end()) it = ref.begin();
+            CHECK(table.remove(it->first));
+            ref.erase(it);
+        }
+        else {
+            int value = rng.below(1000000);
+            table.insert(key, value);
+            ref[key] = value;
+        }
+        if (step % 2500 == 0) checkTable(table, ref, 7);
+        if (step == 10000) {
+            table.setMode(1 - mode);
+            checkTable(table, ref, 7);
+            table.setMode(mode);
+        }
+    }
+    ref.erase(7);
+    table.remove(7);
+    checkTable(table, ref, 7);
+
+    vector<int> saved = copyOf(table.serialize());
+    HashTable restored(1 - mode);
+    CHECK(restored.deserialize(saved.data(), (int)saved.size()));
+    CHECK(restored.getMode() == mode);
+    checkTable(restored, ref, 7);
+    CHECK(copyOf(restored.exportTable()) == copyOf(table.exportTable()));
+
+    table.shrinkToFit();
+    checkTable(table, ref, 7);
+}
+
+void testStringHashTable(int mode) {
+    Random rng(seed + 10 + mode);
+    StringHashTable table(mode);
+    map<string, int> ref;
+    for (int step = 0; step < 10000; step++) {
+        string key = "k" + intToString(rng.below(3000));
+        if (rng.below(3) == 0) {
+            CHECK(table.remove(key) == (ref.erase(key) == 1));
+        }
+        else {
+            int value = rng.below(1000);
+            table.insert(key, value);
+            ref[key] = value;
+        }
+        if (step % 1000 == 0) checkTable(table, ref, string("missing"));
+    }
+    checkTable(table, ref, string("missing"));
+}
+
+// ===================== DIFFERENTIAL: HEAPS =====================
+void testBinaryHeap(bool minHeap, int arity) {
+    Random rng(seed + arity);
+    BinaryHeap heap(minHeap, 4, arity);
+    multiset<int> ref;
+    for (int step = 0; step < 20000; step++) {
+        if (rng.below(3) == 0 && !ref.empty()) {
+            int expected = minHeap ? *ref.begin() : *ref.rbegin();
+            CHECK(heap.extractTop() == expected);
+            ref.erase(minHeap ? ref.begin() : --ref.end());
+        }
+        else {
+            int value = rng.below(5000) - 2500;
+            heap.insert(value);
+            ref.insert(value);
+        }
+        CHECK(heap.getSize() == (int)ref.size());
+    }
+
+    vector<int> saved = copyOf(heap.serialize());
+    BinaryHeap restored;
+    CHECK(restored.deserialize(saved.data(), (int)saved.size()));
+    CHECK(restored.getIsMinHeap() == minHeap && restored.getArity() == arity);
+    while (!ref.empty()) {
+        int expected = minHeap ? *ref.begin() : *ref.rbegin();
+        if (restored.extractTop() != expected) {
+            CHECK(false);
+            break;
+        }
+        ref.erase(minHeap ? ref.begin() : --ref.end());
+    }
+    CHECK(restored.getSize() == 0);
+}
+
+void testPersistentHeap() {
+    Random rng(seed + 20);
+    PersistentHeap heap(true);
+    map<int, multiset<int> > history;
+    multiset<int> ref;
+    history[heap.getVersion()] = ref;
+    for (int step = 0; step < 3000; step++) {
+        if (rng.below(3) == 0 && !ref.empty()) {
+            CHECK(heap.extractTop() == *ref.begin());
+            ref.erase(ref.begin());
+        }
+        else {
+            int value = rng.below(1000);
+            heap.insert(value);
+            ref.insert(value);
+        }
+        history[heap.getVersion()] = ref;
+    }
+    CHECK(heap.getVersionCount() == (int)history.size());
+    for (map<int, multiset<int> >::iterator it = history.begin(); it != history.end(); ++it) {
+        vector<int> contents = copyOf(heap.exportArrayAt(it->first));
+        sort(contents.begin(), contents.end());
+        if (contents != vector<int>(it->second.begin(), it->second.end())) {
+            CHECK(false);
+            break;
+        }
+    }
+
+    // Branching from an old version drops the later ones
+    int mid = heap.getVersionCount() / 2;
+    CHECK(heap.checkout(mid));
+    ref = history[mid];
+    heap.insert(-1);
+    ref.insert(-1);
+    CHECK(heap.getVersion() == mid + 1 && heap.getVersionCount() == mid + 2);
+    CHECK(heap.extractTop() == -1);
+    CHECK(heap.getSize() == (int)ref.size() - 1);
+    CHECK(!heap.checkout(heap.getVersionCount()));
+}
+
+void testPersistentAvl() {
+    Random rng(seed + 30);
+    PersistentAVLTree tree;
+    map<int, set<int> > history;
+    set<int> ref;
+    history[tree.getVersion()] = ref;
+    for (int step = 0; step < 3000; step++) {
+        int key = rng.below(600);
+        if (rng.below(3) == 0) {
+            tree.remove(key);
+            ref.erase(key);
+        }
+        else {
+            tree.insert(key);
+            ref.insert(key);
+        }
+        history[tree.getVersion()] = ref;
+    }
+    CHECK(tree.getVersionCount() == (int)history.size());
+    vector<int> keys;
+    for (map<int, set<int> >::iterator it = history.begin(); it != history.end(); ++it) {
+        bool same = treeKeys(tree.exportTreeAt(it->first), keys) &&
+                    keys == vector<int>(it->second.begin(), it->second.end());
+        if (!same) {
+            CHECK(same);
+            break;
+        }
+        CHECK(tree.getSizeAt(it->first) == (int)it->second.size());
+    }
+    int mid = tree.getVersionCount() / 3;
+    CHECK(tree.checkout(mid));
+    for (int key = 0; key < 600; key += 7) CHECK(tree.contains(key) == (history[mid].count(key) == 1));
+}
+
+// ===================== DIFFERENTIAL: GRAPH =====================
+// O(n^2) Dijkstra on a dense weight matrix (0 = no edge)
+vector<int> plainDijkstra(const vector<int>& weight, int n, int start) {
+    vector<int> dist(n, 999999);
+    vector<bool> done(n, false);
+    dist[start] = 0;
+    for (int round = 0; round < n; round++) {
+        int u = -1;
+        for (int v = 0; v < n; v++) {
+            if (!done[v] && dist[v] < 999999 && (u == -1 || dist[v] < dist[u])) u = v;
+        }
+        if (u == -1) break;
+        done[u] = true;
+        for (int v = 0; v < n; v++) {
+            int w = weight[u * n + v];
+            if (w != 0 && dist[u] + w < dist[v]) dist[v] = dist[u] + w;
+        }
+    }
+    return dist;
+}
+
+void testGraph(int storage, bool directed) {
+    Random rng(seed + 40 + storage * 2 + (directed ? 1 : 0));
+    for (int round = 0; round < 8; round++) {
+        int n = 20 + rng.below(120);
+        Graph graph(n, directed, storage);
+        vector<int> weight(n * n, 0);
+        int edges = n * (1 + rng.below(4));
+        for (int e = 0; e < edges; e++) {
+            int u = rng.below(n);
+            int v = rng.below(n);
+            if (u == v || weight[u * n + v] != 0) continue;
+            int w = (storage == STORAGE_BITSET) ? 1 : 1 + rng.below(50);
+            graph.addEdge(u, v, w);
+            weight[u * n + v] = w;
+            if (!directed) weight[v * n + u] = w;
+        }
+        for (int q = 0; q < 4; q++) {
+            int start = rng.below(n);
+            vector<int> expected = plainDijkstra(weight, n, start);
+            CHECK(copyOf(graph.dijkstraDistances(start)) == expected);
+            CHECK(copyOf(graph.deltaSteppingDistances(start, 0)) == expected);
+            int target = rng.below(n);
+            graph.bidirectionalPath(start, target);
+            CHECK(graph.getPathDistance() == expected[target]);
+        }
+
+        vector<int> saved = copyOf(graph.serialize());
+        Graph restored(0, false, STORAGE_CSR);
+        CHECK(restored.deserialize(saved.data(), (int)saved.size()));
+        CHECK(restored.getStorageMode() == storage && restored.getVertexCount() == n);
+        CHECK(copyOf(restored.dijkstraDistances(0)) == plainDijkstra(weight, n, 0));
+    }
+}
+
+// Removal only tombstones: ids stay put however many go, until compact()
+void testGraphRemoval() {
+    Graph graph(64, true, STORAGE_CSR);
+    for (int v = 0; v + 1 < 64; v++) graph.addEdge(v, v + 1, 1);
+    graph.addEdge(0, 63, 100);
+    vector<int> doomed;
+    for (int v = 1; v < 60; v++) {
+        if (v % 8 != 0) doomed.push_back(v);
+    }
+    CHECK(graph.removeVertices(doomed.data(), (int)doomed.size()) == (int)doomed.size());
+    CHECK(graph.removeVertex(62));
+    CHECK(graph.getCompactionCount() == 0 && graph.getVertexCount() == 64);
+    CHECK(graph.isAlive(63) && graph.isAlive(8) && !graph.isAlive(62));
+    CHECK(copyOf(graph.dijkstraDistances(0))[63] == 100);
+
+    graph.compact();
+    int live = graph.getLiveVertexCount();
+    CHECK(graph.getCompactionCount() == 1 && graph.getVertexCount() == live);
+    CHECK(graph.getIdMap().data[63] == live - 1);
+    CHECK(copyOf(graph.dijkstraDistances(0))[live - 1] == 100);
+}
+
+// ===================== FORCE LAYOUT =====================
+// Bodies on one point share a depth-limit leaf; each must still be
+// repelled once per step. At the frame centre gravity is zero, so a body
+// that missed its repulsion would not move at all.
+void testLayoutStacked() {
+    for (int n = 2; n <= 40; n += 19) {
+        Graph graph(n, false, STORAGE_CSR);
+        ForceLayout layout(graph, 100.0f, 100.0f);
+        vector<float> xy(n * 2, 50.0f);
+        CHECK(layout.setPositions(xy.data(), n * 2));
+        layout.step(1);
+        const float* p = layout.getPositions();
+        for (int v = 0; v < n; v++) {
+            float dx = p[v * 2] - 50.0f;
+            float dy = p[v * 2 + 1] - 50.0f;
+            CHECK(dx * dx + dy * dy > 1e-6f);
+        }
+    }
+}
+
+// Compaction renumbers the survivors; their positions and pins follow
+void testLayoutCompaction() {
+    Graph graph(4, false, STORAGE_CSR);
+    graph.addEdge(1, 3, 1);
+    ForceLayout layout(graph, 100.0f, 100.0f);
+    const float xy[8] = {0, 0, 10, 10, 20, 20, 30, 30};
+    CHECK(layout.setPositions(xy, 8));
+    layout.setPinned(3, true);
+    CHECK(graph.removeVertex(0));
+    graph.compact();
+    int v = graph.addVertex(); // new id 3, after the compaction
+    layout.sync();
+    const float* p = layout.getPositions();
+    CHECK(layout.getVertexCount() == 4 && v == 3);
+    CHECK(p[0] == 10 && p[1] == 10 && p[2] == 20 && p[3] == 20 && p[4] == 30 && p[5] == 30);
+    CHECK(layout.isPinned(2) && !layout.isPinned(3));
+    CHECK(layout.getEdgeCount() == 1);
+}
+
+// ===================== REJECTION: SNAPSHOTS =====================
+// Damages a valid snapshot in the generic ways every deserialize must catch
+template <typename Saved>
+void checkDamaged(Saved& owner, const vector<int>& good, int otherKind) {
+    vector<int> words = good;
+    CHECK(owner.deserialize(words.data(), 0) == false);
+    CHECK(owner.deserialize(words.data(), (int)words.size() - 1) == false);
+    for (int i = 0; i < (int)words.size(); i += 1 + (int)words.size() / 16) {
+        vector<int> flipped = words;
+        flipped[i] ^= 0x100;
+        CHECK(owner.deserialize(flipped.data(), (int)flipped.size()) == false);
+    }
+    vector<int> kind = words;
+    kind[2] = otherKind;
+    CHECK(owner.deserialize(kind.data(), (int)kind.size()) == false);
+    vector<int> longer = words;
+    longer.push_back(0);
+    CHECK(owner.deserialize(longer.data(), (int)longer.size()) == false);
+}
+
+void testHeapRejects() {
+    BinaryHeap heap;
+    for (int i = 0; i < 50; i++) heap.insert(i * 3);
+    vector<int> good = copyOf(heap.serialize());
+    checkDamaged(heap, good, SNAPSHOT_AVL);
+
+    IntBuffer bad;
+    {
+        SnapshotWriter out(bad, SNAPSHOT_HEAP);
+        out.put(1);
+        out.put(3); // no such arity
+        out.put(1);
+        out.put(5);
+        out.finish();
+    }
+    CHECK(!heap.deserialize(bad.data, bad.size));
+    {
+        SnapshotWriter out(bad, SNAPSHOT_HEAP);
+        out.put(1);
+        out.put(2);
+        out.put(1000000000); // more values than the payload holds
+        out.put(5);
+        out.finish();
+    }
+    CHECK(!heap.deserialize(bad.data, bad.size));
+    // Every rejection left the contents as they were
+    CHECK(copyOf(heap.serialize()) == good);
+}
+
+void testAvlRejects() {
+    AVLTree tree;
+    for (int i = 0; i < 50; i++) tree.insert(i * 7);
+    vector<int> good = copyOf(tree.serialize());
+    checkDamaged(tree, good, SNAPSHOT_HEAP);
+
+    // Not a BST preorder, repeated keys, an unbalanced chain
+    const int shapes[3][3] = {{2, 3, 1}, {1, 1, 2}, {1, 2, 3}};
+    for (int s = 0; s < 3; s++) {
+        IntBuffer bad;
+        SnapshotWriter out(bad, SNAPSHOT_AVL);
+        out.put(3);
+        for (int i = 0; i < 3; i++) out.put(shapes[s][i]);
+        out.finish();
+        CHECK(!tree.deserialize(bad.data, bad.size));
+    }
+    // Every rejection left the contents as they were
+    CHECK(copyOf(tree.serialize()) == good);
+}
+
+// Header of a Graph payload up to and including the tombstone list
+void graphHeader(SnapshotWriter& out, int n, bool directed, int storage) {
+    out.put(n);
+    out.put(directed ? 1 : 0);
+    out.put(storage);
+    out.put(0);
+    out.putFloat(1.0f);
+    out.put(0);
+}
+
+void testGraphRejects() {
+    Graph graph(6, false, STORAGE_CSR);
+    graph.addEdge(0, 1, 4);
+    graph.addEdge(1, 2, 5);
+    graph.removeVertex(5);
+    vector<int> good = copyOf(graph.serialize());
+    checkDamaged(graph, good, SNAPSHOT_HASH);
+    vector<int> before = copyOf(graph.serialize());
+
+    IntBuffer bad;
+    {
+        SnapshotWriter out(bad, SNAPSHOT_GRAPH);
+        graphHeader(out, 2147483647, false, STORAGE_CSR);
+        out.put(0);
+        out.put(0);
+        out.finish();
+    }
+    CHECK(!graph.deserialize(bad.data, bad.size));
+    // Repeated tombstone, endpoint out of range, zero weight, a bad last
+    // edge after good ones
+    const int cases[4][8] = {
+        {2, 3, 3, 0, 0, 0, 0, 0},
+        {0, 1, 0, 9, 1, 0, 0, 0},
+        {0, 1, 0, 1, 0, 0, 0, 0},
+        {0, 2, 0, 1, 2, 1, 9, 3}};
+    for (int c = 0; c < 4; c++) {
+        SnapshotWriter out(bad, SNAPSHOT_GRAPH);
+        graphHeader(out, 8, true, STORAGE_CSR);
+        const int* w = cases[c];
+        int at = 0;
+        int dead = w[at++];
+        out.put(dead);
+        for (int i = 0; i < dead; i++) out.put(w[at++]);
+        int entries = w[at++];
+        out.put(entries);
+        for (int i = 0; i < entries * 3; i++) out.put(w[at++]);
+        out.finish();
+        CHECK(!graph.deserialize(bad.data, bad.size));
+    }
+    // Rejections leave the graph exactly as it was
+    CHECK(copyOf(graph.serialize()) == before);
+
+    // A matrix grown past the snapshot limit comes back as CSR instead of
+    // allocating n^2 cells
+    Graph wide(3000, false, STORAGE_MATRIX);
+    wide.addEdge(0, 2999, 7);
+    vector<int> saved = copyOf(wide.serialize());
+    Graph restored(0, false, STORAGE_MATRIX);
+    CHECK(restored.deserialize(saved.data(), (int)saved.size()));
+    CHECK(restored.getStorageMode() == STORAGE_CSR && restored.getVertexCount() == 3000);
+    CHECK(copyOf(restored.dijkstraDistances(0))[2999] == 7);
+    {
+        SnapshotWriter out(bad, SNAPSHOT_GRAPH);
+        graphHeader(out, 100000, false, STORAGE_MATRIX);
+        out.put(0);
+        out.put(0);
+        out.finish();
+    }
+    CHECK(restored.deserialize(bad.data, bad.size) && restored.getStorageMode() == STORAGE_CSR);
+}
+
+void testHashRejects() {
+    HashTable table(HASH_OPEN_ADDRESSING);
+    for (int i = 0; i < 10; i++) table.insert(i * 5, i);
+    vector<int> good = copyOf(table.serialize());
+    checkDamaged(table, good, SNAPSHOT_GRAPH);
+
+    // Every slot full: probes for a missing key would never stop
+    IntBuffer bad;
+    {
+        SnapshotWriter out(bad, SNAPSHOT_HASH);
+        out.put(HASH_OPEN_ADDRESSING);
+        out.putFloat(0.75f);
+        out.put(16);
+        out.put(16);
+        out.put(0);
+        for (int i = 0; i < 16; i++) {
+            out.put(i);
+            out.put(i);
+            out.put(i);
+        }
+        out.finish();
+    }
+    CHECK(!table.deserialize(bad.data, bad.size));
+    // Capacity not a power of two, a slot out of range, a slot used twice:
+    // capacity, then two (slot, key, value) entries
+    const int layouts[3][7] = {
+        {12, 0, 0, 0, 1, 1, 1},
+        {16, 16, 1, 0, 0, 0, 0},
+        {16, 3, 1, 3, 3, 2, 0}};
+    for (int c = 0; c < 3; c++) {
+        const int* w = layouts[c];
+        SnapshotWriter out(bad, SNAPSHOT_HASH);
+        out.put(HASH_OPEN_ADDRESSING);
+        out.putFloat(0.75f);
+        out.put(2);
+        out.put(w[0]);
+        out.put(0);
+        for (int i = 1; i < 7; i++) out.put(w[i]);
+        out.finish();
+        CHECK(!table.deserialize(bad.data, bad.size));
+    }
+    // A key one slot past its home, with the home slot empty, is
+    // unreachable. The export is the slot count, then per slot 0 or 1
+    // followed by that many (key, value) pairs.
+    {
+        HashTable probe(HASH_OPEN_ADDRESSING);
+        probe.insert(1, 1);
+        vector<int> slots = copyOf(probe.exportTable());
+        int home = 0;
+        for (int at = 1; slots[at] == 0; at++) home++;
+        SnapshotWriter out(bad, SNAPSHOT_HASH);
+        out.put(HASH_OPEN_ADDRESSING);
+        out.putFloat(0.75f);
+        out.put(1);
+        out.put(slots[0]);
+        out.put(0);
+        out.put((home + 1) % slots[0]);
+        out.put(1);
+        out.put(1);
+        out.finish();
+        CHECK(!table.deserialize(bad.data, bad.size));
+    }
+    // The chained layout with a pair missing
+    {
+        SnapshotWriter out(bad, SNAPSHOT_HASH);
+        out.put(HASH_CHAINING);
+        out.putFloat(0.75f);
+        out.put(2);
+        out.put(1);
+        out.put(1);
+        out.put(2);
+        out.finish();
+    }
+    CHECK(!table.deserialize(bad.data, bad.size));
+    // Every rejection left the contents as they were
+    CHECK(copyOf(table.serialize()) == good);
+}
+
+// ===================== REJECTION: GRAPH LOADER =====================
+bool loadText(GraphLoader& loader, const char* text) {
+    return loader.feed(text, (int)strlen(text)) && loader.finish();
+}
+
+void testLoaderRejects() {
+    const char* bad[] = {
+        "0 1\n1 x\n",
+        "0 1\n-3 2\n",
+        "0 1\n100000000 2\n",
+        "%%MatrixMarket matrix coordinate integer general\n3 3 2\n1 2 5\n",
+        "%%MatrixMarket matrix coordinate integer general\n3 3 1\n4 1 5\n",
+        "%%MatrixMarket matrix coordinate integer general\n100000000 100000000 1\n1 2 3\n"};
+    for (int i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++) {
+        Graph graph(0, false, STORAGE_CSR);
+        GraphLoader loader(graph);
+        CHECK(!loadText(loader, bad[i]));
+        CHECK(loader.getError().size() > 0);
+        CHECK(graph.getVertexCount() <= 3);
+    }
+
+    // Sparse ids load densely once remapped
+    Graph graph(0, false, STORAGE_CSR);
+    GraphLoader loader(graph);
+    loader.setRemapIds(true);
+    CHECK(loadText(loader, "0 1\n100000000 2\n"));
+    CHECK(graph.getVertexCount() == 4 && graph.getEdgeCount() == 4);
+    const int ids[] = {0, 1, 100000000, 2};
+    CHECK(copyOf(loader.getOriginalIds()) == vector<int>(ids, ids + 4));
+
+    Graph limited(0, false, STORAGE_CSR);
+    GraphLoader capped(limited);
+    capped.setRemapIds(true);
+    capped.setMaxVertices(3);
+    CHECK(!loadText(capped, "0 1\n100000000 2\n"));
+
+    // A line split across chunks still parses
+    Graph split(0, true, STORAGE_CSR);
+    GraphLoader chunks(split);
+    CHECK(chunks.feed("0 1 4\n1", 7) && chunks.feed(" 2 6\n", 5) && chunks.finish());
+    CHECK(split.getEdgeCount() == 2 && copyOf(split.dijkstraDistances(0))[2] == 10);
+}
+
+// ===================== MAIN =====================
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+    }
+
+    testAvl();
+    testHashTable(HASH_CHAINING);
+    testHashTable(HASH_OPEN_ADDRESSING);
+    testStringHashTable(HASH_CHAINING);
+    testStringHashTable(HASH_OPEN_ADDRESSING);
+    testBinaryHeap(true, 2);
+    testBinaryHeap(false, 4);
+    testPersistentHeap();
+    testPersistentAvl();
+    for (int storage = STORAGE_MATRIX; storage <= STORAGE_BITSET; storage++) {
+        testGraph(storage, false);
+        testGraph(storage, true);
+    }
+    testGraphRemoval();
+    testLayoutStacked();
+    testLayoutCompaction();
+    testHeapRejects();
+    testAvlRejects();
+    testGraphRejects();
+    testHashRejects();
+    testLoaderRejects();
+
+    printf("%d checks, %d failed (seed %u)\n", checks, failures, seed);
+    return failures == 0 ? 0 : 1;
+}